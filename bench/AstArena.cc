@@ -0,0 +1,57 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Parses a synthetic program into an arena: parse time, the time to drop the tree, and how much the
+// peak RSS grows while the tree is alive. Tokens are lexed up front so only the parser is timed.
+// Usage: bench_ast_arena [functions=40000]
+#include "Arena.hh"
+#include "Bench.hh"
+#include "Lexer.hh"
+#include "Parser.hh"
+#include <chrono>
+#include <memory>
+#include <print>
+#include <sys/resource.h>
+
+namespace {
+    long peak_rss_kb() {
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    double ms_since(const std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(const int argc, char** argv) {
+    const auto functions = static_cast<unsigned>(ent::bench::argument(argc, argv, 1, 40000));
+    const std::string source = ent::bench::synthetic_program(functions);
+    ent::lexer lexer{std::string_view(source)};
+    const std::vector<ent::lexer::token> tokens = std::move(lexer.get_tokens());
+    std::print("{} functions, {:.1f} MB, {} tokens\n", functions, source.size() / 1e6, tokens.size());
+
+    double parse = std::numeric_limits<double>::max();
+    double drop = std::numeric_limits<double>::max();
+    long grown_kb = 0;
+    for (int run = 0; run < 3; ++run) {
+        std::vector<ent::lexer::token> copy = tokens;
+        const long rss_before = peak_rss_kb();
+        auto nodes = std::make_unique<ent::arena>();
+        auto start = std::chrono::steady_clock::now();
+        ent::parser parser(std::move(copy), lexer.get_lines(), *nodes);
+        if (parser.parse_program() == nullptr) {
+            return 1;
+        }
+        parse = std::min(parse, ms_since(start));
+        // Only the first run raises the peak, later ones reuse the pages it left behind
+        if (run == 0) {
+            grown_kb = peak_rss_kb() - rss_before;
+        }
+        start = std::chrono::steady_clock::now();
+        nodes.reset();
+        drop = std::min(drop, ms_since(start));
+    }
+    std::print("parse {:.1f} ms, dropping the tree {:.1f} ms, peak RSS +{} MB\n", parse, drop, grown_kb / 1024);
+}
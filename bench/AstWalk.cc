@@ -0,0 +1,110 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Counts every node of a synthetic program's tree, once through ast::visit and once through a
+// node_cast if-chain, the shape the parser's dynamic_pointer_cast chains used to have.
+// Usage: bench_ast_walk [functions=40000]
+#include "Arena.hh"
+#include "Bench.hh"
+#include "Lexer.hh"
+#include "Parser.hh"
+#include <print>
+
+using namespace ent::ast;
+
+namespace {
+    struct counter {
+        size_t operator()(const program_node& n) { return 1 + all(n.m_elements); }
+        size_t operator()(const function_prototype_node& n) { return 1 + all(n.m_parameters); }
+        size_t operator()(const function_node& n) { return 1 + all(n.m_parameters) + walk(n.body()); }
+        size_t operator()(const body_node& n) { return 1 + all(n.m_statements); }
+        size_t operator()(const variable_declaration_assign_node& n) { return 1 + walk(n.m_rhs); }
+        size_t operator()(const assignment_node& n) { return 1 + walk(n.m_rhs); }
+        size_t operator()(const expression_node& n) { return 1 + walk(n.m_lhs) + walk(n.m_rhs); }
+        size_t operator()(const extern_node& n) { return 1 + walk(n.m_child); }
+        size_t operator()(const return_node& n) { return 1 + walk(n.m_value); }
+        size_t operator()(const index_assignment_node& n) { return 1 + walk(n.m_index) + walk(n.m_rhs); }
+        size_t operator()(const member_invoke_node& n) { return 1 + walk(n.m_base); }
+        size_t operator()(const element_call_node& n) { return 1 + all(n.m_arguments) + walk(n.m_base); }
+        size_t operator()(const if_node& n) { return 1 + walk(n.m_condition) + walk(n.m_true_body) + walk(n.m_false_body); }
+        size_t operator()(const while_node& n) { return 1 + walk(n.m_condition) + walk(n.m_body); }
+        size_t operator()(const switch_node& n) { return 1 + walk(n.m_expression) + all(n.m_cases) + walk(n.m_default_case); }
+        size_t operator()(const case_node& n) { return 1 + walk(n.m_value) + walk(n.m_body); }
+        size_t operator()(const function_call_node& n) { return 1 + all(n.m_arguments); }
+        size_t operator()(const index_access_node& n) { return 1 + walk(n.m_index); }
+        size_t operator()(const unary_node& n) { return 1 + walk(n.m_operand); }
+        size_t operator()(const binary_node& n) { return 1 + walk(n.m_lhs) + walk(n.m_rhs); }
+        size_t operator()(const auto&) { return 1; }
+
+        size_t walk(const base_node* node) { return node ? visit(*node, *this) : 0; }
+        size_t all(const node_list nodes) {
+            size_t count = 0;
+            for (const base_node* node : nodes) {
+                count += walk(node);
+            }
+            return count;
+        }
+    };
+
+    size_t cascade(const base_node* node);
+
+    size_t cascade_all(const node_list nodes) {
+        size_t count = 0;
+        for (const base_node* node : nodes) {
+            count += cascade(node);
+        }
+        return count;
+    }
+
+    size_t cascade(const base_node* node) {
+        if (!node) return 0;
+        if (auto n = node_cast<program_node>(node)) return 1 + cascade_all(n->m_elements);
+        if (auto n = node_cast<function_prototype_node>(node)) return 1 + cascade_all(n->m_parameters);
+        if (auto n = node_cast<function_node>(node)) return 1 + cascade_all(n->m_parameters) + cascade(n->body());
+        if (auto n = node_cast<body_node>(node)) return 1 + cascade_all(n->m_statements);
+        if (node_cast<variable_declaration_node>(node)) return 1;
+        if (auto n = node_cast<variable_declaration_assign_node>(node)) return 1 + cascade(n->m_rhs);
+        if (auto n = node_cast<assignment_node>(node)) return 1 + cascade(n->m_rhs);
+        if (node_cast<parameter_node>(node)) return 1;
+        if (auto n = node_cast<expression_node>(node)) return 1 + cascade(n->m_lhs) + cascade(n->m_rhs);
+        if (auto n = node_cast<extern_node>(node)) return 1 + cascade(n->m_child);
+        if (auto n = node_cast<return_node>(node)) return 1 + cascade(n->m_value);
+        if (node_cast<continue_node>(node) || node_cast<break_node>(node)) return 1;
+        if (node_cast<increment_node>(node) || node_cast<decrement_node>(node)) return 1;
+        if (auto n = node_cast<index_assignment_node>(node)) return 1 + cascade(n->m_index) + cascade(n->m_rhs);
+        if (auto n = node_cast<member_invoke_node>(node)) return 1 + cascade(n->m_base);
+        if (auto n = node_cast<element_call_node>(node)) return 1 + cascade_all(n->m_arguments) + cascade(n->m_base);
+        if (auto n = node_cast<if_node>(node)) return 1 + cascade(n->m_condition) + cascade(n->m_true_body) + cascade(n->m_false_body);
+        if (auto n = node_cast<while_node>(node)) return 1 + cascade(n->m_condition) + cascade(n->m_body);
+        if (auto n = node_cast<switch_node>(node)) return 1 + cascade(n->m_expression) + cascade_all(n->m_cases) + cascade(n->m_default_case);
+        if (auto n = node_cast<case_node>(node)) return 1 + cascade(n->m_value) + cascade(n->m_body);
+        if (auto n = node_cast<function_call_node>(node)) return 1 + cascade_all(n->m_arguments);
+        if (node_cast<variable_node>(node)) return 1;
+        if (auto n = node_cast<index_access_node>(node)) return 1 + cascade(n->m_index);
+        if (node_cast<string_literal_node>(node) || node_cast<literal_node>(node)) return 1;
+        if (auto n = node_cast<unary_node>(node)) return 1 + cascade(n->m_operand);
+        if (auto n = node_cast<binary_node>(node)) return 1 + cascade(n->m_lhs) + cascade(n->m_rhs);
+        return 1;
+    }
+}
+
+int main(const int argc, char** argv) {
+    const auto functions = static_cast<unsigned>(ent::bench::argument(argc, argv, 1, 40000));
+    const std::string source = ent::bench::synthetic_program(functions);
+    ent::lexer lexer{std::string_view(source)};
+    ent::arena nodes;
+    ent::parser parser(std::move(lexer.get_tokens()), std::move(lexer.get_lines()), nodes);
+    const base_node* program = parser.parse_program();
+
+    size_t visited = 0;
+    size_t cascaded = 0;
+    const double visit_ms = ent::bench::best_ms(7, [&] { visited = counter{}.walk(program); });
+    const double cascade_ms = ent::bench::best_ms(7, [&] { cascaded = cascade(program); });
+    if (visited != cascaded) {
+        std::print("NODE COUNTS DIFFER: {} vs {}\n", visited, cascaded);
+        return 1;
+    }
+    std::print("{} nodes\n", visited);
+    std::print("  ast::visit:         {:5.1f} ms ({:.1f} ns/node)\n", visit_ms, visit_ms * 1e6 / visited);
+    std::print("  node_cast if-chain: {:5.1f} ms ({:.1f} ns/node)\n", cascade_ms, cascade_ms * 1e6 / cascaded);
+}
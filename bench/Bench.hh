@@ -0,0 +1,53 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef BENCH_HH
+#define BENCH_HH
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iterator>
+#include <limits>
+#include <string>
+
+namespace ent::bench {
+    // Best wall time of `runs` calls, in milliseconds
+    template <typename Body>
+    double best_ms(const int runs, Body&& body) {
+        double best = std::numeric_limits<double>::max();
+        for (int i = 0; i < runs; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            body();
+            const auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    // argv[index] as a number, `fallback` when it is not given
+    inline unsigned long argument(const int argc, char** argv, const int index, const unsigned long fallback) {
+        return index < argc ? std::strtoul(argv[index], nullptr, 10) : fallback;
+    }
+
+    // A program of `functions` functions using every kind of statement, about 400 bytes and 100 tokens each
+    inline std::string synthetic_program(const unsigned functions) {
+        std::string text = "extern fn printf(byte* fmt, dword x) -> dword;\ndword counter = 0;\n";
+        for (unsigned i = 0; i < functions; ++i) {
+            std::format_to(std::back_inserter(text),
+                "fn f{0}(word a, word* b, dword c) -> dword {{\n"
+                "    dword x{0} = a * 3 + c / 2 - {0};\n"
+                "    word y = b[a + 1];\n"
+                "    if (x{0} > 10 || c == 0) {{ x{0} = x{0} - 1; printf(\"v %u\", x{0}); }} else if (a < 3) {{ y++; }} else {{ --y; }}\n"
+                "    while (c > 0 && y != 7) {{ c--; y = y.add(c, 0x1f); }}\n"
+                "    switch (a) {{ case 1: return 1; case 2: break; default: continue; }}\n"
+                "    return f{1}(a, b, (x{0} + y) * 0b101);\n"
+                "}};\n", i, i == 0 ? 0 : i - 1);
+        }
+        return text;
+    }
+}
+
+#endif //BENCH_HH
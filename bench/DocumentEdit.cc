@@ -0,0 +1,40 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Single-character edits to a large document against building it from scratch. Each edit types a
+// digit into a literal somewhere in the buffer and the next one deletes it again, so every edit parses.
+// Usage: bench_document_edit [functions=6250] (8 lines each, 50k lines by default)
+#include "Bench.hh"
+#include "Document.hh"
+#include <print>
+#include <random>
+#include <utility>
+#include <vector>
+
+int main(const int argc, char** argv) {
+    const auto functions = static_cast<unsigned>(ent::bench::argument(argc, argv, 1, 6250));
+    const std::string source = ent::bench::synthetic_program(functions);
+    const auto lines = std::ranges::count(source, '\n');
+
+    std::vector<size_t> literals;
+    for (size_t at = source.find(" / 2 - "); at != std::string::npos; at = source.find(" / 2 - ", at + 1)) {
+        literals.push_back(at + 7);
+    }
+
+    const double build = ent::bench::best_ms(3, [&] { const ent::document doc(source); });
+
+    ent::document doc(source);
+    std::mt19937 random(5);
+    std::vector<double> edits;
+    for (int round = 0; round < 2000; ++round) {
+        const size_t at = literals[random() % literals.size()];
+        edits.push_back(ent::bench::best_ms(1, [&] { doc.edit(at, 0, "1"); }));
+        edits.push_back(ent::bench::best_ms(1, [&] { doc.edit(at, 1, ""); }));
+    }
+    std::ranges::sort(edits);
+    std::print("{} lines, {:.1f} MB\n", lines, source.size() / 1e6);
+    for (const auto& [name, ms] : {std::pair{"full build", build}, {"edit, median", edits[edits.size() / 2]},
+                                   {"edit, 99th percentile", edits[edits.size() * 99 / 100]}, {"edit, worst", edits.back()}}) {
+        std::print("  {:<22} {:7.3f} ms\n", name, ms);
+    }
+}
@@ -0,0 +1,67 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Preprocesses a synthetic include tree with an increasing number of scan workers.
+// Usage: bench_include_tree [files=1000]
+#include "Bench.hh"
+#include "Preprocessor.hh"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <print>
+#include <thread>
+
+namespace {
+    // File i exports a few prototypes and re-exports files 2i+1 and 2i+2, plus a file shared with
+    // its neighbour, so the graph is wide and has diamonds for the table to deduplicate
+    std::filesystem::path write_tree(const unsigned files) {
+        const std::filesystem::path root = std::filesystem::temp_directory_path() / "ent_include_tree";
+        std::filesystem::create_directories(root);
+        const auto name = [&root](const unsigned i) { return (root / std::format("f{}.e", i)).string(); };
+        for (unsigned i = 0; i < files; ++i) {
+            std::ofstream out(name(i));
+            out << "header {\n";
+            for (const unsigned child : {2 * i + 1, 2 * i + 2, (i + files / 2) | 1}) {
+                if (child > i && child < files) {
+                    out << std::format("    include \"{}\"\n", name(child));
+                }
+            }
+            for (unsigned f = 0; f < 8; ++f) {
+                out << std::format("    fn f{}_{}(word a, dword* b) -> dword;\n", i, f);
+            }
+            out << "}\n\n";
+            for (unsigned f = 0; f < 8; ++f) {
+                out << std::format("fn f{}_{}(word a, dword* b) -> dword {{\n    return b[a] * {} + f{}_{}(a - 1, b);\n}};\n",
+                                   i, f, f, i, (f + 1) % 8);
+            }
+        }
+        return name(0);
+    }
+}
+
+int main(const int argc, char** argv) {
+    const auto files = static_cast<unsigned>(ent::bench::argument(argc, argv, 1, 1000));
+    const std::string root = write_tree(files).string();
+    const unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+
+    std::print("{} files, {} hardware threads\n", files, hardware);
+    std::size_t reference = 0;
+    for (unsigned workers = 0;; workers = workers == 0 ? 1 : workers * 2) {
+        workers = std::min(workers, hardware - 1);
+        std::size_t hash = 0;
+        std::size_t bytes = 0;
+        const double ms = ent::bench::best_ms(5, [&] {
+            ent::interface_table table(workers);
+            ent::preprocessor pp(root, table);
+            bytes = pp.get_preprocessed().size();
+            hash = std::hash<std::string>{}(pp.get_preprocessed());
+        });
+        if (workers == 0) {
+            reference = hash;
+        }
+        std::print("workers {:>3}: {:8.2f} ms  {} bytes{}\n", workers, ms, bytes, hash == reference ? "" : "  OUTPUT DIFFERS");
+        if (workers == hardware - 1) {
+            break;
+        }
+    }
+}
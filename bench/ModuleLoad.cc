@@ -0,0 +1,35 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Time to get a synthetic program's tree by lexing and parsing it against loading its module image.
+// Usage: bench_module_load [functions=40000]
+#include "Arena.hh"
+#include "Bench.hh"
+#include "Lexer.hh"
+#include "Parser.hh"
+#include "Serialize.hh"
+#include <print>
+
+int main(const int argc, char** argv) {
+    const auto functions = static_cast<unsigned>(ent::bench::argument(argc, argv, 1, 40000));
+    const std::string source = ent::bench::synthetic_program(functions);
+
+    std::string image;
+    const double parse = ent::bench::best_ms(5, [&] {
+        ent::arena nodes;
+        ent::lexer lexer{std::string_view(source)};
+        ent::parser parser(std::move(lexer.get_tokens()), std::move(lexer.get_lines()), nodes);
+        const ent::ast::base_node_ptr program = parser.parse_program();
+        if (image.empty()) {
+            image = ent::ast::serialize(*program, 0);
+        }
+    });
+    const double load = ent::bench::best_ms(5, [&] {
+        ent::arena nodes;
+        ent::ast::deserialize(image, nodes);
+    });
+
+    std::print("{} functions, source {:.1f} MB, image {:.1f} MB\n", functions, source.size() / 1e6, image.size() / 1e6);
+    std::print("  lex + parse: {:6.1f} ms\n", parse);
+    std::print("  load image:  {:6.1f} ms ({:.1f}x faster)\n", load, parse / load);
+}
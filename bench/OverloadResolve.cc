@@ -0,0 +1,74 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Resolves a million calls against a module of 2500 overloads, once by mangling the call's signature
+// and looking the symbol up by name, and once through overload_index.
+// Usage: bench_overload_resolve [calls=1000000]
+#include "Arena.hh"
+#include "Bench.hh"
+#include "Lexer.hh"
+#include "Overload.hh"
+#include "Parser.hh"
+#include <optional>
+#include <print>
+#include <unordered_map>
+#include <vector>
+
+int main(const int argc, char** argv) {
+    const auto calls = static_cast<unsigned>(ent::bench::argument(argc, argv, 1, 1000000));
+    constexpr unsigned names = 500;
+    constexpr std::string_view receivers[] = {"byte", "word", "dword", "qword", "word*"};
+
+    std::string source;
+    for (unsigned f = 0; f < names; ++f) {
+        for (const std::string_view receiver : receivers) {
+            std::format_to(std::back_inserter(source), "fn f{}({} a, word b) -> word {{ return b; }};\n", f, receiver);
+        }
+    }
+    source += "extern fn puts(byte* s) -> dword;\nfn main() -> void { };\n";
+    ent::lexer lexer{std::string_view(source)};
+    ent::arena nodes;
+    ent::parser parser(std::move(lexer.get_tokens()), std::move(lexer.get_lines()), nodes);
+    const auto* program = ent::ast::node_cast<ent::ast::program_node>(parser.parse_program());
+
+    std::optional<ent::overload_index> index;
+    const double build = ent::bench::best_ms(5, [&] { index.emplace(*program); });
+
+    std::unordered_map<std::string, std::int64_t> by_symbol;
+    for (std::uint32_t i = 0; i < index->size(); ++i) {
+        by_symbol.emplace((*index)[i].symbol, i);
+    }
+    std::vector<ent::symbol_id> name_ids;
+    for (unsigned f = 0; f < names; ++f) {
+        name_ids.push_back(ent::symbol_table::intern(std::format("f{}", f)));
+    }
+    const ent::type_id word = ent::type_table::primitive(ent::primitive_type::Word);
+    const ent::type_id firsts[] = {ent::type_table::primitive(ent::primitive_type::Byte), word,
+                                   ent::type_table::primitive(ent::primitive_type::DWord),
+                                   ent::type_table::primitive(ent::primitive_type::QWord), ent::type_table::pointer_to(word)};
+
+    std::int64_t mangled_sum = 0;
+    const double mangled = ent::bench::best_ms(3, [&] {
+        mangled_sum = 0;
+        for (unsigned i = 0; i < calls; ++i) {
+            const ent::type_id arguments[] = {firsts[i % 5], word};
+            mangled_sum += by_symbol.find(ent::mangle_function(ent::symbol_table::name(name_ids[i % names]), arguments))->second;
+        }
+    });
+    std::int64_t resolved_sum = 0;
+    const double resolved = ent::bench::best_ms(3, [&] {
+        resolved_sum = 0;
+        for (unsigned i = 0; i < calls; ++i) {
+            const ent::type_id arguments[] = {firsts[i % 5], word};
+            resolved_sum += index->resolve(name_ids[i % names], arguments);
+        }
+    });
+    if (mangled_sum != resolved_sum) {
+        std::print("RESOLUTIONS DIFFER\n");
+        return 1;
+    }
+
+    std::print("{} overloads, index built in {:.2f} ms, {} calls\n", index->size(), build, calls);
+    std::print("  mangle + symbol lookup:  {:6.1f} ms\n", mangled);
+    std::print("  overload_index::resolve: {:6.1f} ms\n", resolved);
+}
@@ -0,0 +1,130 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Compiles an IR sample through codegen at every optimization level, links it with the system
+// compiler driver and times the program. The emitters are not in the tree, so the samples are
+// hand-written IR shaped like their output, loaded into the codegen's module. Run from the
+// repository root; the driver is $CC, or cc.
+//
+// With --pgo the sample is built at -O2 three times instead: plain, instrumented, and with the
+// profile the instrumented run wrote. The instrumented build links through $PGO_CC (clang by
+// default) with -fprofile-instr-generate for the profile runtime, and $PROFDATA (llvm-profdata)
+// merges the raw profile.
+// Usage: bench_pipeline [sample=bench/ir/collatz.ll] [--time-passes | --pgo]
+#include "Bench.hh"
+#include "Codegen.hh"
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/SourceMgr.h>
+#include <filesystem>
+#include <optional>
+#include <print>
+#include <utility>
+
+namespace {
+    constexpr std::pair<ent::opt_level, std::string_view> levels[] = {
+        {ent::opt_level::O0, "O0"}, {ent::opt_level::O1, "O1"}, {ent::opt_level::O2, "O2"},
+        {ent::opt_level::O3, "O3"}, {ent::opt_level::Os, "Os"},
+    };
+
+    std::string tool(const char* variable, const std::string_view fallback) {
+        const char* value = std::getenv(variable);
+        return value && *value ? value : std::string(fallback);
+    }
+
+    // The sample moved into the codegen's module, which decides the triple and data layout
+    bool load(ent::codegen& codegen, const std::string& path) {
+        llvm::Module& module = *codegen.get_module();
+        llvm::SMDiagnostic diagnostic;
+        std::unique_ptr<llvm::Module> sample = llvm::parseIRFile(path, diagnostic, module.getContext());
+        if (!sample) {
+            diagnostic.print("bench_pipeline", llvm::errs());
+            return false;
+        }
+        sample->setTargetTriple(module.getTargetTriple());
+        sample->setDataLayout(module.getDataLayout());
+        return !llvm::Linker::linkModules(module, std::move(sample));
+    }
+
+    struct build {
+        ent::opt_level level;
+        ent::profile_mode profile = ent::profile_mode::None;
+        std::string profile_path;
+        bool time_passes = false;
+    };
+
+    // Compiles and links `sample` into the executable `output`, returning the compile time in
+    // milliseconds, or nothing if any step failed
+    std::optional<double> compile(const std::string& sample, const build& options, const std::string& output) {
+        ent::codegen codegen("pipeline");
+        if (!load(codegen, sample)) {
+            return std::nullopt;
+        }
+        codegen.set_optimization(options.level);
+        codegen.set_time_passes(options.time_passes);
+        codegen.set_profile(options.profile, options.profile_path);
+        const auto start = std::chrono::steady_clock::now();
+        if (!codegen.compile_to_object(output + ".o")) {
+            return std::nullopt;
+        }
+        const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const std::string link = options.profile == ent::profile_mode::Generate
+            ? std::format("{} -fprofile-instr-generate {}.o -o {}", tool("PGO_CC", "clang"), output, output)
+            : std::format("{} {}.o -o {}", tool("CC", "cc"), output, output);
+        if (std::system(link.c_str()) != 0) {
+            std::print("failed: {}\n", link);
+            return std::nullopt;
+        }
+        return elapsed;
+    }
+
+    double run_ms(const std::string& program) {
+        const std::string command = std::format("{} > /dev/null", program);
+        return ent::bench::best_ms(3, [&] { std::system(command.c_str()); });
+    }
+
+    int levels_bench(const std::string& sample, const std::string& stem, const bool time_passes) {
+        for (const auto& [level, name] : levels) {
+            const std::optional<double> compiled = compile(sample, {level, ent::profile_mode::None, {}, time_passes}, stem);
+            if (!compiled) {
+                return 1;
+            }
+            std::print("-{}: compile {:7.1f} ms, run {:7.1f} ms\n", name, *compiled, run_ms(stem));
+        }
+        return 0;
+    }
+
+    int pgo_bench(const std::string& sample, const std::string& stem) {
+        const std::string raw = stem + ".profraw";
+        const std::string merged = stem + ".profdata";
+        const std::string plain = stem + "_plain";
+        const std::string instrumented = stem + "_instr";
+        const std::string optimized = stem + "_pgo";
+        if (!compile(sample, {ent::opt_level::O2}, plain)
+            || !compile(sample, {ent::opt_level::O2, ent::profile_mode::Generate, raw}, instrumented)) {
+            return 1;
+        }
+        std::filesystem::remove(raw);
+        const double training = ent::bench::best_ms(1, [&] {
+            std::system(std::format("LLVM_PROFILE_FILE={} {} > /dev/null", raw, instrumented).c_str());
+        });
+        if (std::system(std::format("{} merge -o {} {}", tool("PROFDATA", "llvm-profdata"), merged, raw).c_str()) != 0
+            || !compile(sample, {ent::opt_level::O2, ent::profile_mode::Use, merged}, optimized)) {
+            return 1;
+        }
+        std::print("-O2 plain:        run {:7.1f} ms\n", run_ms(plain));
+        std::print("-O2 instrumented: run {:7.1f} ms (training run)\n", training);
+        std::print("-O2 with profile: run {:7.1f} ms\n", run_ms(optimized));
+        return 0;
+    }
+}
+
+int main(const int argc, char** argv) {
+    const std::string sample = argc > 1 && argv[1][0] != '-' ? argv[1] : "bench/ir/collatz.ll";
+    const std::string_view mode = argv[argc - 1];
+    const std::string stem = (std::filesystem::temp_directory_path() / "ent_pipeline").string();
+    if (mode == "--pgo") {
+        return pgo_bench(sample, stem);
+    }
+    return levels_bench(sample, stem, mode == "--time-passes");
+}
@@ -0,0 +1,56 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Lexer throughput in MB/s under every scan kernel set the CPU supports; scalar is the
+// one-character-at-a-time baseline. Usage: bench_scan_kernels [megabytes=32]
+#include "Bench.hh"
+#include "Check.hh"
+#include "Lexer.hh"
+#include "Scan.hh"
+#include <print>
+
+namespace {
+    std::string repeat(const std::string_view unit, const size_t bytes) {
+        std::string text;
+        text.reserve(bytes + unit.size());
+        while (text.size() < bytes) {
+            text += unit;
+        }
+        return text;
+    }
+
+    // Ordinary code: main.e over and over
+    std::string code_input(const size_t bytes) {
+        return repeat(ent::test::read_file("main.e") + "\n", bytes);
+    }
+
+    // Long comments, strings and indentation, where the kernels skip the most per call
+    std::string comment_input(const size_t bytes) {
+        return repeat("        // a line comment explaining the next call in some detail, as comments do\n"
+                      "        /* a block comment that spans a couple of lines\n"
+                      "           and keeps going for a while before it ends */\n"
+                      "        printf(\"a fairly long format string with a value %u and an escape \\n\", value);\n",
+                      bytes);
+    }
+}
+
+int main(const int argc, char** argv) {
+    const size_t bytes = ent::bench::argument(argc, argv, 1, 32) << 20;
+    const std::pair<std::string_view, std::string> inputs[] = {
+        {"code", code_input(bytes)},
+        {"comments/strings", comment_input(bytes)},
+    };
+
+    for (const auto& [name, text] : inputs) {
+        std::print("{} ({} MB)\n", name, text.size() >> 20);
+        for (const ent::scan::kernels* set : ent::scan::supported()) {
+            ent::scan::override_active(*set);
+            size_t tokens = 0;
+            const double ms = ent::bench::best_ms(3, [&] {
+                ent::lexer lexer{std::string_view(text)};
+                tokens = lexer.get_tokens().size();
+            });
+            std::print("  {:>7}: {:8.1f} MB/s  ({} tokens)\n", set->name, text.size() / 1048576.0 / (ms / 1000), tokens);
+        }
+    }
+}
@@ -0,0 +1,144 @@
+; An if-chain whose last arm takes 99.4% of 100M calls; the cold arms call a heavy mixing function.
+; Shaped like codegen output where it matters: locals of main live in allocas.
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+declare i32 @printf(ptr, ...)
+
+define i64 @_E3mixq(i64 %v) {
+entry:
+  %z = icmp eq i64 %v, 0
+  br i1 %z, label %zero, label %go
+zero:
+  ret i64 1
+go:
+  %m0 = mul i64 %v, 2654435761
+  %m1 = xor i64 %m0, 2177342782468422677
+  %m2 = add i64 %m1, 35
+  %m3 = lshr i64 %m2, 13
+  %m4 = mul i64 %m3, 2654435761
+  %m5 = xor i64 %m4, 2177342782468422677
+  %m6 = add i64 %m5, 103
+  %m7 = lshr i64 %m6, 13
+  %m8 = mul i64 %m7, 2654435761
+  %m9 = xor i64 %m8, 2177342782468422677
+  %m10 = add i64 %m9, 171
+  %m11 = lshr i64 %m10, 13
+  %m12 = mul i64 %m11, 2654435761
+  %m13 = xor i64 %m12, 2177342782468422677
+  %m14 = add i64 %m13, 239
+  %m15 = lshr i64 %m14, 13
+  %m16 = mul i64 %m15, 2654435761
+  %m17 = xor i64 %m16, 2177342782468422677
+  %m18 = add i64 %m17, 307
+  %m19 = lshr i64 %m18, 13
+  %m20 = mul i64 %m19, 2654435761
+  %m21 = xor i64 %m20, 2177342782468422677
+  %m22 = add i64 %m21, 375
+  %m23 = lshr i64 %m22, 13
+  %m24 = mul i64 %m23, 2654435761
+  %m25 = xor i64 %m24, 2177342782468422677
+  %m26 = add i64 %m25, 443
+  %m27 = lshr i64 %m26, 13
+  %m28 = mul i64 %m27, 2654435761
+  %m29 = xor i64 %m28, 2177342782468422677
+  %m30 = add i64 %m29, 511
+  %m31 = lshr i64 %m30, 13
+  %m32 = mul i64 %m31, 2654435761
+  %m33 = xor i64 %m32, 2177342782468422677
+  %m34 = add i64 %m33, 579
+  %m35 = lshr i64 %m34, 13
+  %m36 = mul i64 %m35, 2654435761
+  %m37 = xor i64 %m36, 2177342782468422677
+  %m38 = add i64 %m37, 647
+  %m39 = lshr i64 %m38, 13
+  %m40 = mul i64 %m39, 2654435761
+  %m41 = xor i64 %m40, 2177342782468422677
+  %m42 = add i64 %m41, 715
+  %m43 = lshr i64 %m42, 13
+  %m44 = mul i64 %m43, 2654435761
+  %m45 = xor i64 %m44, 2177342782468422677
+  %m46 = add i64 %m45, 783
+  %m47 = lshr i64 %m46, 13
+  %m48 = mul i64 %m47, 2654435761
+  %m49 = xor i64 %m48, 2177342782468422677
+  %m50 = add i64 %m49, 851
+  %m51 = lshr i64 %m50, 13
+  %m52 = mul i64 %m51, 2654435761
+  %m53 = xor i64 %m52, 2177342782468422677
+  %m54 = add i64 %m53, 919
+  %m55 = lshr i64 %m54, 13
+  %m56 = mul i64 %m55, 2654435761
+  %m57 = xor i64 %m56, 2177342782468422677
+  %m58 = add i64 %m57, 987
+  %m59 = lshr i64 %m58, 13
+  %m60 = mul i64 %m59, 2654435761
+  %m61 = xor i64 %m60, 2177342782468422677
+  %m62 = add i64 %m61, 1055
+  %m63 = lshr i64 %m62, 13
+  %m64 = mul i64 %m63, 2654435761
+  %m65 = xor i64 %m64, 2177342782468422677
+  %m66 = add i64 %m65, 1123
+  %m67 = lshr i64 %m66, 13
+  %m68 = mul i64 %m67, 2654435761
+  %m69 = xor i64 %m68, 2177342782468422677
+  ret i64 %m69
+}
+
+define i64 @_E4stepqq(i64 %s, i64 %k) {
+entry:
+  %m = urem i64 %k, 1000
+  %a = icmp ult i64 %m, 2
+  br i1 %a, label %c0, label %t1
+c0:
+  %x0 = call i64 @_E3mixq(i64 %s)
+  %y0 = call i64 @_E3mixq(i64 %x0)
+  ret i64 %y0
+t1:
+  %b = icmp ult i64 %m, 4
+  br i1 %b, label %c1, label %t2
+c1:
+  %x1 = add i64 %s, 99
+  %y1 = call i64 @_E3mixq(i64 %x1)
+  ret i64 %y1
+t2:
+  %c = icmp ult i64 %m, 6
+  br i1 %c, label %c2, label %hot
+c2:
+  %x2 = call i64 @_E3mixq(i64 %k)
+  %y2 = xor i64 %x2, %s
+  ret i64 %y2
+hot:
+  %x3 = and i64 %s, 4095
+  %y3 = add i64 %x3, %k
+  ret i64 %y3
+}
+
+define i32 @main() {
+entry:
+  %i = alloca i64
+  %seed = alloca i64
+  %total = alloca i64
+  store i64 0, ptr %i
+  store i64 12345, ptr %seed
+  store i64 0, ptr %total
+  br label %cond
+cond:
+  %iv = load i64, ptr %i
+  %c = icmp slt i64 %iv, 100000000
+  br i1 %c, label %body, label %out
+body:
+  %s = load i64, ptr %seed
+  %s1 = mul i64 %s, 2862933555777941757
+  %s2 = add i64 %s1, 3037000493
+  store i64 %s2, ptr %seed
+  %k = lshr i64 %s2, 33
+  %t = load i64, ptr %total
+  %v = call i64 @_E4stepqq(i64 %t, i64 %k)
+  store i64 %v, ptr %total
+  %iv1 = add i64 %iv, 1
+  store i64 %iv1, ptr %i
+  br label %cond
+out:
+  %tv = load i64, ptr %total
+  call i32 (ptr, ...) @printf(ptr @fmt, i64 %tv)
+  ret i32 0
+}
@@ -0,0 +1,92 @@
+; Collatz step counts over 3M inputs, then a sum over the array they were stored in.
+; Shaped like codegen output: every local an alloca, loads and stores around each use
+@fmt = private constant [5 x i8] c"%ld\0A\00"
+declare i32 @printf(ptr, ...)
+
+define i64 @_E7collatzq(i64 %n) {
+entry:
+  %n.addr = alloca i64
+  %steps = alloca i64
+  store i64 %n, ptr %n.addr
+  store i64 0, ptr %steps
+  br label %cond
+cond:
+  %v = load i64, ptr %n.addr
+  %c = icmp ne i64 %v, 1
+  br i1 %c, label %body, label %done
+body:
+  %v2 = load i64, ptr %n.addr
+  %r = srem i64 %v2, 2
+  %even = icmp eq i64 %r, 0
+  br i1 %even, label %half, label %triple
+half:
+  %h = sdiv i64 %v2, 2
+  store i64 %h, ptr %n.addr
+  br label %next
+triple:
+  %t = mul i64 %v2, 3
+  %t1 = add i64 %t, 1
+  store i64 %t1, ptr %n.addr
+  br label %next
+next:
+  %s = load i64, ptr %steps
+  %s1 = add i64 %s, 1
+  store i64 %s1, ptr %steps
+  br label %cond
+done:
+  %res = load i64, ptr %steps
+  ret i64 %res
+}
+
+define i32 @main() {
+entry:
+  %i = alloca i64
+  %total = alloca i64
+  %arr = alloca [4096 x i64]
+  store i64 1, ptr %i
+  store i64 0, ptr %total
+  br label %cond
+cond:
+  %iv = load i64, ptr %i
+  %c = icmp slt i64 %iv, 3000000
+  br i1 %c, label %body, label %sum
+body:
+  %iv2 = load i64, ptr %i
+  %k = call i64 @_E7collatzq(i64 %iv2)
+  %tot = load i64, ptr %total
+  %tot1 = add i64 %tot, %k
+  store i64 %tot1, ptr %total
+  %slot = and i64 %iv2, 4095
+  %p = getelementptr [4096 x i64], ptr %arr, i64 0, i64 %slot
+  store i64 %k, ptr %p
+  %iv3 = add i64 %iv2, 1
+  store i64 %iv3, ptr %i
+  br label %cond
+sum:
+  %j = alloca i64
+  %acc = alloca i64
+  store i64 0, ptr %j
+  store i64 0, ptr %acc
+  br label %scond
+scond:
+  %jv = load i64, ptr %j
+  %sc = icmp slt i64 %jv, 4096000
+  br i1 %sc, label %sbody, label %out
+sbody:
+  %jv2 = load i64, ptr %j
+  %jm = and i64 %jv2, 4095
+  %q = getelementptr [4096 x i64], ptr %arr, i64 0, i64 %jm
+  %e = load i64, ptr %q
+  %a = load i64, ptr %acc
+  %a1 = add i64 %a, %e
+  store i64 %a1, ptr %acc
+  %jv3 = add i64 %jv2, 1
+  store i64 %jv3, ptr %j
+  br label %scond
+out:
+  %t = load i64, ptr %total
+  %av = load i64, ptr %acc
+  %r = add i64 %t, %av
+  call i32 (ptr, ...) @printf(ptr @fmt, i64 %r)
+  ret i32 0
+}
@@ -5,8 +5,7 @@
 #include <format>
 
 namespace ent::ast {
-    base_node::~base_node() = default;
-    void base_node::print(int indent) const {
-        std::println("Base node (default print): Type = {}", static_cast<int>(m_type));
+    void base_node::print(const int indent) const {
+        visit(*this, [indent](const auto& node) { node.print(indent); });
     }
 }
\ No newline at end of file
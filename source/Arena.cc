@@ -0,0 +1,70 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Arena.hh"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+namespace ent {
+    namespace {
+        // Blocks double up to this size, past it the allocator hands them straight back to the OS anyway
+        constexpr size_t max_block_size = 4 * 1024 * 1024;
+    }
+
+    arena::arena(const size_t block_size) : m_next_block(block_size) {}
+
+    void* arena::allocate(const size_t size, const size_t alignment) {
+        auto address = reinterpret_cast<std::uintptr_t>(m_cursor);
+        auto aligned = (address + alignment - 1) & ~(alignment - 1);
+        if (!m_cursor || aligned + size > reinterpret_cast<std::uintptr_t>(m_end)) {
+            grow(size, alignment);
+            address = reinterpret_cast<std::uintptr_t>(m_cursor);
+            aligned = (address + alignment - 1) & ~(alignment - 1);
+        }
+        m_used += aligned - address + size;
+        m_cursor = reinterpret_cast<std::byte*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void arena::grow(const size_t size, const size_t alignment) {
+        const size_t block_size = std::max(m_next_block, size + alignment);
+        m_next_block = std::min(m_next_block * 2, max_block_size);
+        // Left uninitialised, pages the tree never reaches are never touched
+        m_blocks.push_back({std::make_unique_for_overwrite<std::byte[]>(block_size), block_size});
+        m_cursor = m_blocks.back().data.get();
+        m_end = m_cursor + block_size;
+    }
+
+    void arena::reset() noexcept {
+        m_used = 0;
+        if (m_blocks.empty()) {
+            return;
+        }
+        m_blocks.erase(m_blocks.begin(), m_blocks.end() - 1);
+        m_cursor = m_blocks.back().data.get();
+        m_end = m_cursor + m_blocks.back().size;
+    }
+
+    void arena::absorb(arena& other) {
+        // In front, the block being bumped through has to stay last
+        m_blocks.insert(m_blocks.begin(), std::make_move_iterator(other.m_blocks.begin()), std::make_move_iterator(other.m_blocks.end()));
+        m_used += other.m_used;
+        other.m_blocks.clear();
+        other.m_cursor = nullptr;
+        other.m_end = nullptr;
+        other.m_used = 0;
+    }
+
+    size_t arena::used() const noexcept {
+        return m_used;
+    }
+
+    size_t arena::reserved() const noexcept {
+        size_t total = 0;
+        for (const block& b : m_blocks) {
+            total += b.size;
+        }
+        return total;
+    }
+}
@@ -0,0 +1,74 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef ARENA_HH
+#define ARENA_HH
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ent {
+    // Bump allocator for objects that all die together, like the nodes of one compilation's AST.
+    // Nothing allocated here is ever destroyed, so only trivially destructible types go in, and
+    // releasing everything is handing back a few large blocks. Not safe to share between threads.
+    class arena {
+    public:
+        explicit arena(size_t block_size = 64 * 1024);
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        void* allocate(size_t size, size_t alignment);
+
+        template <typename T, typename... Args>
+        T* make(Args&&... args) {
+            static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+            return ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        template <typename T>
+        std::span<const T> copy(const std::span<const T> items) {
+            static_assert(std::is_trivially_copyable_v<T>, "arena spans are copied bytewise");
+            if (items.empty()) {
+                return {};
+            }
+            void* storage = allocate(items.size_bytes(), alignof(T));
+            std::memcpy(storage, items.data(), items.size_bytes());
+            return {static_cast<const T*>(storage), items.size()};
+        }
+
+        // Drops everything allocated so far, keeping the newest block for reuse
+        void reset() noexcept;
+        // Takes over the blocks of `other`, so what was made there now lives as long as this arena.
+        // `other` is left empty.
+        void absorb(arena& other);
+
+        // Bytes handed out since construction or the last reset
+        [[nodiscard]] size_t used() const noexcept;
+        // Bytes held in blocks
+        [[nodiscard]] size_t reserved() const noexcept;
+
+    private:
+        struct block {
+            std::unique_ptr<std::byte[]> data;
+            size_t size;
+        };
+
+        void grow(size_t size, size_t alignment);
+
+        std::vector<block> m_blocks;
+        size_t m_next_block;
+        std::byte* m_cursor = nullptr;
+        std::byte* m_end = nullptr;
+        size_t m_used = 0;
+    };
+}
+
+#endif //ARENA_HH
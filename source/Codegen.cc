@@ -1,45 +1,72 @@
 
 
 #include "Codegen.hh"
-#include <llvm/Support/TargetSelect.h>
-#include <llvm/MC/TargetRegistry.h>
 #include <llvm/Target/TargetMachine.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Passes/StandardInstrumentations.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/PGOOptions.h>
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/ThinLTOBitcodeWriter.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <format>
 #include <ranges>
 
 namespace ent {
-    codegen::codegen(const std::string_view module_name)
-        : m_context(std::make_unique<llvm::LLVMContext>()),
-          m_module(std::make_unique<llvm::Module>(std::string(module_name), *m_context)),
-          m_builder(std::make_unique<llvm::IRBuilder<>>(*m_context)) {
-        llvm::InitializeAllTargetInfos();
-        llvm::InitializeAllTargets();
-        llvm::InitializeAllTargetMCs();
-        llvm::InitializeAllAsmPrinters();
-        llvm::InitializeAllAsmParsers();
-
-        const std::string target_triple = m_target_triple.empty() ? "x86_64-pc-linux-gnu" : m_target_triple;
-        std::string error;
-        const auto target_ptr = llvm::TargetRegistry::lookupTarget(target_triple, error);
-        if (!target_ptr) {
-            throw std::runtime_error("Failed to lookup target: " + error);
-        }
-        m_target = std::make_unique<llvm::Target>(*target_ptr);
-
-        const llvm::TargetOptions opt;
-        auto RM = llvm::Reloc::Model::PIC_;
-        m_target_machine = std::unique_ptr<llvm::TargetMachine>(
-            m_target->createTargetMachine(target_triple, "generic", "", opt, RM)
-        );
-        if (!m_target_machine) {
-            throw std::runtime_error("Failed to create target machine");
+    namespace {
+        // Runs the backend, timed as a whole when `enabled`. The legacy pass manager only times its
+        // passes one by one through the process-wide TimePassesIsEnabled, so it is not asked to.
+        template <typename Body>
+        void time_backend(const bool enabled, Body&& body) {
+            if (!enabled) {
+                body();
+                return;
+            }
+            llvm::TimerGroup group("backend", "Backend");
+            llvm::Timer timer("codegen", "Code generation", group);
+            timer.startTimer();
+            body();
+            timer.stopTimer();
+            group.print(llvm::errs(), /*ResetAfterPrint=*/true);
         }
+    }
 
-        m_module->setDataLayout(m_target_machine->createDataLayout());
-        m_module->setTargetTriple(target_triple);
+    std::optional<opt_level> parse_opt_level(const std::string_view flag) {
+        if (flag == "-O0") return opt_level::O0;
+        if (flag == "-O1") return opt_level::O1;
+        if (flag == "-O2") return opt_level::O2;
+        if (flag == "-O3") return opt_level::O3;
+        if (flag == "-Os") return opt_level::Os;
+        return std::nullopt;
+    }
 
+    llvm::CodeGenOptLevel codegen_opt_level(const opt_level level) {
+        switch (level) {
+            case opt_level::O0: return llvm::CodeGenOptLevel::None;
+            case opt_level::O1: return llvm::CodeGenOptLevel::Less;
+            case opt_level::O2:
+            case opt_level::Os: return llvm::CodeGenOptLevel::Default;
+            case opt_level::O3: return llvm::CodeGenOptLevel::Aggressive;
+        }
+        return llvm::CodeGenOptLevel::Default;
+    }
+
+    codegen::codegen(const std::string_view module_name, target_options target)
+        : m_context(std::make_unique<llvm::LLVMContext>()),
+          m_module(std::make_unique<llvm::Module>(std::string(module_name), *m_context)),
+          m_builder(std::make_unique<llvm::IRBuilder<>>(*m_context)),
+          m_target_options(std::move(target)) {
+        retarget();
     }
 
     llvm::Module* codegen::get_module() const {
@@ -47,8 +74,19 @@ namespace ent {
     }
 
     void codegen::set_target_triple(const std::string_view triple) {
-        m_target_triple = std::string(triple);
-        m_module->setTargetTriple(m_target_triple);
+        m_target_options.triple = std::string(triple);
+        retarget();
+    }
+
+    void codegen::set_target(target_options target) {
+        m_target_options = std::move(target);
+        retarget();
+    }
+
+    void codegen::retarget() {
+        m_target_machine = target_cache::machine(m_target_options, codegen_opt_level(m_opt_level));
+        m_module->setDataLayout(m_target_machine->createDataLayout());
+        m_module->setTargetTriple(m_target_machine->getTargetTriple().str());
     }
 
     void codegen::set_data_layout(const std::string_view layout) const {
@@ -77,117 +115,187 @@ namespace ent {
         return m_module->getFunction(name.data());
     }
 
-    std::string codegen::mangle_name(const std::string_view base_name, const std::vector<variable_type>& args) {
-        std::ostringstream mangled;
-        mangled << "_E" << base_name.length() << base_name;
+    std::string codegen::mangle_name(const std::string_view base_name, const std::span<const type_id> args) {
+        return mangle_function(base_name, args);
+    }
 
-        for (const auto& arg : args) {
-            mangled << mangle_type(arg);
-        }
-        return mangled.str();
+    void codegen::index_overloads(const ast::program_node& root) {
+        m_overloads.emplace(root);
+        m_overload_functions.assign(m_overloads->size(), nullptr);
     }
 
-    std::string codegen::mangle_type(const variable_type& vtype) {
-        if (vtype.pointer != 0) {
-            auto new_vtype = vtype;
-            --new_vtype.pointer;
-            return "P" + mangle_type(new_vtype);
+    llvm::Function* codegen::resolve_call(const symbol_id name, const std::span<const type_id> arguments) {
+        const std::int64_t index = m_overloads->resolve(name, arguments);
+        if (index < 0) {
+            return nullptr;
         }
-        if (vtype.is_struct) {
-            return "S" + std::to_string(vtype.base_type.length()) + vtype.base_type;
+        llvm::Function*& function = m_overload_functions[index];
+        if (!function) {
+            function = m_module->getFunction((*m_overloads)[static_cast<std::uint32_t>(index)].symbol);
         }
+        return function;
+    }
 
-        if (vtype.base_type == "void") return "v";
-        if (vtype.base_type == "byte") return "b";
-        if (vtype.base_type == "word") return "w";
-        if (vtype.base_type == "dword") return "d";
-        if (vtype.base_type == "qword") return "q";
-        if (vtype.base_type == "sbyte") return "B";
-        if (vtype.base_type == "sword") return "W";
-        if (vtype.base_type == "sdword") return "D";
-        if (vtype.base_type == "sqword") return "Q";
-
-        return std::to_string(vtype.base_type.length()) + vtype.base_type; // Should be unreachable
+    std::string_view codegen::mangle_type(const type_id type) {
+        return type_table::mangled(type);
     }
 
-    llvm::Type* codegen::get_llvm_primitive_type(const std::string_view base_type) const {
-        if (base_type == "byte" || base_type == "sbyte") {
-            return llvm::Type::getInt8Ty(*m_context);
-        }
-        if (base_type == "word" || base_type == "sword") {
-            return llvm::Type::getInt16Ty(*m_context);
-        }
-        if (base_type == "dword" || base_type == "sdword") {
-            return llvm::Type::getInt32Ty(*m_context);
-        }
-        if (base_type == "qword" || base_type == "qdword") {
-            return llvm::Type::getInt64Ty(*m_context);
+    llvm::Type* codegen::get_llvm_primitive_type(const primitive_type type) const {
+        switch (type) {
+            case primitive_type::Void: return llvm::Type::getVoidTy(*m_context);
+            case primitive_type::Byte:
+            case primitive_type::SByte: return llvm::Type::getInt8Ty(*m_context);
+            case primitive_type::Word:
+            case primitive_type::SWord: return llvm::Type::getInt16Ty(*m_context);
+            case primitive_type::DWord:
+            case primitive_type::SDWord: return llvm::Type::getInt32Ty(*m_context);
+            case primitive_type::QWord:
+            case primitive_type::SQWord: return llvm::Type::getInt64Ty(*m_context);
         }
         return nullptr;
     }
 
-    llvm::Type* codegen::get_llvm_type(const variable_type &vtype) {
-        if (vtype.pointer != 0) {
-            llvm::Type* base_type = get_llvm_primitive_type(vtype.base_type);
-            if (!base_type) {
-                base_type = llvm::StructType::getTypeByName(*m_context, vtype.base_type);
-            }
-            if (base_type) {
-                return llvm::PointerType::getUnqual(base_type);
-            }
+    llvm::Type* codegen::get_llvm_type(const type_id type) {
+        if (type < m_llvm_types.size() && m_llvm_types[type]) {
+            return m_llvm_types[type];
         }
-
-        if (vtype.is_struct) {
-            const auto struct_type = llvm::StructType::create(*m_context, vtype.base_type);
-            std::vector<llvm::Type*> struct_elements;
-
-            for (const auto &val: vtype.struct_values | std::views::values) {
-                llvm::Type* member_type = get_llvm_type(val);
-                if (!member_type) {
-                    return nullptr;
+        const type_entry& entry = type_table::get(type);
+        llvm::Type* result = nullptr;
+        switch (entry.kind) {
+            case type_kind::Primitive:
+                result = get_llvm_primitive_type(entry.primitive);
+                break;
+            case type_kind::Pointer:
+                if (llvm::Type* pointee = get_llvm_type(entry.pointee)) {
+                    result = llvm::PointerType::getUnqual(pointee);
+                }
+                break;
+            case type_kind::Struct: {
+                std::vector<llvm::Type*> struct_elements;
+                for (const type_id member : entry.members | std::views::values) {
+                    llvm::Type* member_type = get_llvm_type(member);
+                    if (!member_type) {
+                        return nullptr;
+                    }
+                    struct_elements.push_back(member_type);
                 }
-                struct_elements.push_back(member_type);
+                result = llvm::StructType::create(*m_context, struct_elements, symbol_table::name(entry.name), /*packed=*/false);
+                break;
             }
-
-            struct_type->setBody(struct_elements, /*packed=*/false);
-            return struct_type;
         }
-
-        llvm::Type* type = get_llvm_primitive_type(vtype.base_type);
-        if (!type) {
-            llvm::errs() << "Unknown type: " << vtype.base_type << "\n";
+        if (!result) {
+            llvm::errs() << "Unknown type: " << type_table::describe(type) << "\n";
+            return nullptr;
         }
-        return type;
+        if (type >= m_llvm_types.size()) {
+            m_llvm_types.resize(type + 1);
+        }
+        m_llvm_types[type] = result;
+        return result;
     }
 
     void codegen::push_scope() {
-        m_symbol_stack.emplace_back();
+        m_symbols.push_scope();
     }
 
     void codegen::pop_scope() {
-        if (!m_symbol_stack.empty()) {
-            m_symbol_stack.pop_back();
-        }
+        m_symbols.pop_scope();
     }
 
-    llvm::Value* codegen::get_variable_value(const std::string_view name) {
-        for (auto & it : std::ranges::reverse_view(m_symbol_stack)) {
-            if (auto found = it.find(std::string(name)); found != it.end()) {
-                return found->second;
-            }
-        }
-        return nullptr;
+    llvm::Value* codegen::get_variable_value(const symbol_id name) const {
+        llvm::Value* const* value = m_symbols.get(name);
+        return value ? *value : nullptr;
     }
 
-    bool codegen::set_variable_value(const std::string_view name, llvm::Value* value) {
-        if (m_symbol_stack.empty()) {
-            return false;
+    bool codegen::set_variable_value(const symbol_id name, llvm::Value* value) {
+        return m_symbols.set(name, value);
+    }
+
+    void codegen::set_optimization(const opt_level level) {
+        m_opt_level = level;
+        // Instruction selection and register allocation follow the IR level
+        retarget();
+    }
+
+    void codegen::set_time_passes(const bool enabled) {
+        m_time_passes = enabled;
+    }
+
+    void codegen::set_profile(const profile_mode mode, const std::string_view path) {
+        m_profile = mode;
+        m_profile_path = std::string(path);
+    }
+
+    void codegen::optimize(llvm::raw_ostream* thin_bitcode) {
+        llvm::LoopAnalysisManager lam;
+        llvm::FunctionAnalysisManager fam;
+        llvm::CGSCCAnalysisManager cgam;
+        llvm::ModuleAnalysisManager mam;
+
+        llvm::PassInstrumentationCallbacks pic;
+        llvm::StandardInstrumentations si(*m_context, /*DebugLogging=*/false);
+        si.registerCallbacks(pic, &mam);
+        // Its own handler rather than the global -time-passes flag, so only this codegen is timed
+        llvm::TimePassesHandler timer(m_time_passes);
+        timer.setOutStream(llvm::errs());
+        timer.registerCallbacks(pic);
+
+        llvm::PipelineTuningOptions tuning;
+        const bool vectorize = m_opt_level == opt_level::O2 || m_opt_level == opt_level::O3 || m_opt_level == opt_level::Os;
+        tuning.LoopVectorization = vectorize;
+        tuning.SLPVectorization = vectorize;
+
+        // IR-level PGO: counters go on a spanning-tree subset of CFG edges, enough to recover every
+        // if, while and switch edge, and the same CFG later maps the counts back onto branches
+        std::optional<llvm::PGOOptions> pgo;
+        if (m_profile != profile_mode::None) {
+            pgo.emplace(m_profile_path, "", "", "", llvm::vfs::getRealFileSystem(),
+                        m_profile == profile_mode::Generate ? llvm::PGOOptions::IRInstr : llvm::PGOOptions::IRUse);
         }
-        m_symbol_stack.back()[std::string(name)] = value;
-        return true;
+
+        llvm::PassBuilder builder(m_target_machine.get(), tuning, pgo, &pic);
+        builder.registerModuleAnalyses(mam);
+        builder.registerCGSCCAnalyses(cgam);
+        builder.registerFunctionAnalyses(fam);
+        builder.registerLoopAnalyses(lam);
+        builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+        llvm::OptimizationLevel level = llvm::OptimizationLevel::O0;
+        switch (m_opt_level) {
+            case opt_level::O0: break;
+            case opt_level::O1: level = llvm::OptimizationLevel::O1; break;
+            case opt_level::O2: level = llvm::OptimizationLevel::O2; break;
+            case opt_level::O3: level = llvm::OptimizationLevel::O3; break;
+            case opt_level::Os:
+                // The pipeline only shrinks code in functions that ask for it
+                for (llvm::Function& function : *m_module) {
+                    if (!function.isDeclaration()) {
+                        function.addFnAttr(llvm::Attribute::OptimizeForSize);
+                    }
+                }
+                level = llvm::OptimizationLevel::Os;
+                break;
+        }
+
+        llvm::ModulePassManager pipeline;
+        if (level == llvm::OptimizationLevel::O0) {
+            pipeline = builder.buildO0DefaultPipeline(level, /*LTOPreLink=*/thin_bitcode != nullptr);
+        } else if (thin_bitcode) {
+            // Inlining across modules happens at the link, so this stops short of the late passes
+            pipeline = builder.buildThinLTOPreLinkDefaultPipeline(level);
+        } else {
+            pipeline = builder.buildPerModuleDefaultPipeline(level);
+        }
+        if (thin_bitcode) {
+            pipeline.addPass(llvm::ThinLTOBitcodeWriterPass(*thin_bitcode, nullptr));
+        }
+        pipeline.run(*m_module, mam);
+        timer.print();
     }
 
     bool codegen::compile_to_object(const std::string_view filename) {
+        optimize();
+
         std::error_code EC;
         llvm::raw_fd_ostream dest(filename.data(), EC, llvm::sys::fs::OF_None);
         if (EC) {
@@ -202,11 +310,137 @@ namespace ent {
             return false;
         }
 
-        pass_manager.run(*m_module);
+        time_backend(m_time_passes, [&] { pass_manager.run(*m_module); });
         dest.flush();
 
         llvm::outs() << "Object file written to " << filename << "\n";
         return true;
     }
 
-}
\ No newline at end of file
+    bool codegen::write_thin_bitcode(const std::string_view filename) {
+        std::error_code EC;
+        llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
+        if (EC) {
+            llvm::errs() << "Could not open file: " << EC.message() << "\n";
+            return false;
+        }
+        optimize(&dest);
+        dest.flush();
+        return !dest.has_error();
+    }
+
+    std::unique_ptr<llvm::TargetMachine> codegen::create_target_machine() const {
+        const llvm::TargetMachine& base = *m_target_machine;
+        return std::unique_ptr<llvm::TargetMachine>(base.getTarget().createTargetMachine(
+            base.getTargetTriple().str(), base.getTargetCPU(), base.getTargetFeatureString(), base.Options,
+            base.getRelocationModel(), base.getCodeModel(), base.getOptLevel()));
+    }
+
+    std::vector<std::string> codegen::compile_to_objects(const std::string_view stem, thread_pool& pool, unsigned partitions) {
+        if (partitions == 0) {
+            partitions = pool.size() + 1;
+        }
+        if (partitions == 1) {
+            std::string filename = std::format("{}.o", stem);
+            return compile_to_object(filename) ? std::vector{std::move(filename)} : std::vector<std::string>();
+        }
+
+        // Inlining and interprocedural passes need the whole module, only the backend is split
+        optimize();
+
+        // Split parts still belong to m_context, which is not thread-safe, so each one crosses
+        // to its thread as bitcode and is read back into a context of its own there
+        std::vector<llvm::SmallString<0>> parts;
+        llvm::SplitModule(*m_module, partitions, [&parts](std::unique_ptr<llvm::Module> part) {
+            llvm::raw_svector_ostream out(parts.emplace_back());
+            llvm::WriteBitcodeToFile(*part, out);
+        });
+
+        struct result {
+            std::string filename;
+            bool written = false;
+        };
+        std::vector<result> results(parts.size());
+        time_backend(m_time_passes, [&] {
+            for (size_t i = 0; i < parts.size(); ++i) {
+                results[i].filename = std::format("{}.{}.o", stem, i);
+                pool.submit([this, &part = parts[i], &r = results[i]] {
+                    llvm::LLVMContext context;
+                    llvm::Expected<std::unique_ptr<llvm::Module>> module =
+                        llvm::parseBitcodeFile(llvm::MemoryBufferRef(part.str(), r.filename), context);
+                    if (!module) {
+                        llvm::consumeError(module.takeError());
+                        return;
+                    }
+                    const std::unique_ptr<llvm::TargetMachine> target_machine = create_target_machine();
+                    std::error_code EC;
+                    llvm::raw_fd_ostream dest(r.filename, EC, llvm::sys::fs::OF_None);
+                    if (EC || !target_machine) {
+                        return;
+                    }
+                    llvm::legacy::PassManager pass_manager;
+                    if (target_machine->addPassesToEmitFile(pass_manager, dest, nullptr, llvm::CodeGenFileType::ObjectFile)) {
+                        return;
+                    }
+                    pass_manager.run(**module);
+                    dest.flush();
+                    r.written = !dest.has_error();
+                });
+            }
+            pool.wait();
+        });
+
+        std::vector<std::string> written;
+        for (result& r : results) {
+            if (!r.written) {
+                llvm::errs() << "Could not emit " << r.filename << "\n";
+                return {};
+            }
+            written.push_back(std::move(r.filename));
+        }
+        llvm::outs() << "Object files written to " << stem << ".*.o\n";
+        return written;
+    }
+
+    int codegen::run(const std::string_view program_name, const std::span<const std::string> arguments) {
+        // The JIT compiles for the machine optimize() tuned the module for, not whatever the host detects
+        llvm::orc::JITTargetMachineBuilder target(m_target_machine->getTargetTriple());
+        target.setCPU(m_target_machine->getTargetCPU().str())
+            .setFeatures(m_target_machine->getTargetFeatureString())
+            .setCodeGenOptLevel(m_target_machine->getOptLevel());
+        llvm::Expected<std::unique_ptr<llvm::orc::LLJIT>> jit = llvm::orc::LLJITBuilder()
+            .setJITTargetMachineBuilder(std::move(target))
+            .create();
+        if (!jit) {
+            throw std::runtime_error("Failed to create JIT: " + llvm::toString(jit.takeError()));
+        }
+
+        // printf and the rest of the C library come from this process
+        llvm::orc::JITDylib& dylib = (*jit)->getMainJITDylib();
+        dylib.addGenerator(llvm::cantFail(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            (*jit)->getDataLayout().getGlobalPrefix())));
+
+        // retarget() already gave the module the triple and data layout the JIT uses
+        optimize();
+        // Everything here points into m_context, which the JIT now owns
+        m_builder.reset();
+        m_llvm_types.clear();
+        m_overload_functions.clear();
+        if (llvm::Error error = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(m_module), std::move(m_context)))) {
+            throw std::runtime_error("Failed to add module to JIT: " + llvm::toString(std::move(error)));
+        }
+
+        llvm::Expected<llvm::orc::ExecutorAddr> entry = (*jit)->lookup("main");
+        if (!entry) {
+            throw std::runtime_error("No main to run: " + llvm::toString(entry.takeError()));
+        }
+        if (llvm::Error error = (*jit)->initialize(dylib)) {
+            throw std::runtime_error("Failed to initialize JIT: " + llvm::toString(std::move(error)));
+        }
+        const int status = llvm::orc::runAsMain(entry->toPtr<int (*)(int, char*[])>(),
+                                                std::vector<std::string>(arguments.begin(), arguments.end()),
+                                                llvm::StringRef(program_name));
+        llvm::consumeError((*jit)->deinitialize(dylib));
+        return status;
+    }
+}
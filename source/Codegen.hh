@@ -5,22 +5,37 @@
 #ifndef CODEGEN_HH
 #define CODEGEN_HH
 
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
-#include <unordered_map>
 #include <vector>
 #include "AST.icc"
+#include "Overload.hh"
+#include "Scope.hh"
+#include "Target.hh"
+#include "ThreadPool.hh"
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/FileSystem.h>
 #include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/CodeGen.h>
 
 namespace ent {
+    enum class opt_level : std::uint8_t { O0, O1, O2, O3, Os };
+
+    enum class profile_mode : std::uint8_t { None, Generate, Use };
+
+    // Level named by a driver flag such as "-O2", nullopt for anything else
+    std::optional<opt_level> parse_opt_level(std::string_view flag);
+    // Backend level for an IR level; -Os keeps the default backend
+    llvm::CodeGenOptLevel codegen_opt_level(opt_level level);
 
     class codegen {
     public:
-        explicit codegen(std::string_view module_name);
+        explicit codegen(std::string_view module_name, target_options target = {});
         ~codegen() = default;
 
         codegen(const codegen&) = delete;
@@ -28,68 +43,110 @@ namespace ent {
         codegen(codegen&&) = delete;
         codegen& operator=(codegen&&) = delete;
 
-        bool generate_code(const std::shared_ptr<ast::program_node> &root);
+        bool generate_code(const ast::program_node& root);
 
         [[nodiscard]] bool write_ir_to_file(std::string_view filename) const;
         bool write_ir_to_stream(std::ostream &os) const;
         void set_target_triple(std::string_view triple);
+        void set_target(target_options target);
         void set_data_layout(std::string_view layout) const;
+        // Runs the matching LLVM pipeline over the module before emission, -O0 by default
+        void set_optimization(opt_level level);
+        // Generate: count every function entry and branch edge, and have the program write the counts to
+        // `path` when it exits; it has to be linked with the LLVM profile runtime. Use: read a profile merged
+        // with llvm-profdata from `path` and attach its counts as branch weights and entry counts.
+        void set_profile(profile_mode mode, std::string_view path);
+        // Times every IR pass of this codegen, and its backend as a whole, reporting to stderr
+        void set_time_passes(bool enabled);
         bool compile_to_object(std::string_view filename);
+        // Runs the ThinLTO pre-link pipeline and writes bitcode carrying a module summary, for thin_link
+        bool write_thin_bitcode(std::string_view filename);
+        // Optimizes the whole module, splits it into `partitions` parts (0 for one per pool thread) and
+        // runs the backend on each in its own context on the pool, writing <stem>.<n>.o. Returns the
+        // objects written, empty if any part failed. Internal symbols are made hidden in the process.
+        std::vector<std::string> compile_to_objects(std::string_view stem, thread_pool& pool, unsigned partitions = 0);
+
+        // JIT-compiles the module in process, resolving externs against the host process, and calls
+        // main(argc, argv) with the program name followed by `arguments`. The module and its context
+        // move into the JIT, so nothing else can be done with this codegen afterwards.
+        int run(std::string_view program_name, std::span<const std::string> arguments);
 
         [[nodiscard]] llvm::Module* get_module() const;
 
     private:
-        static std::string mangle_name(std::string_view base_name, const std::vector<variable_type>& args);
-        static std::string mangle_type(const variable_type& vtype);
-
-        llvm::Value* emit_node(const std::shared_ptr<ast::base_node> &node);
-        llvm::Value* emit_expression_node(const std::shared_ptr<ast::expression_node> &expr);
-        llvm::Value* emit_binary_node(const std::shared_ptr<ast::binary_node> &bin);
-        llvm::Value* emit_unary_node(const std::shared_ptr<ast::unary_node> &un);
-        llvm::Value* emit_literal_node(const std::shared_ptr<ast::literal_node> &lit);
-        llvm::Value* emit_string_literal_node(const std::shared_ptr<ast::string_literal_node> &str);
-        llvm::Value* emit_variable_node(const std::shared_ptr<ast::variable_node> &var);
-        llvm::Value* emit_variable_declaration_node(const std::shared_ptr<ast::variable_declaration_node> &decl);
-        llvm::Value* emit_variable_declaration_assign_node(const std::shared_ptr<ast::variable_declaration_assign_node> &decl_assign);
-        llvm::Value* emit_assignment_node(const std::shared_ptr<ast::assignment_node> &assign);
-        llvm::Value* emit_parameter_node(const std::shared_ptr<ast::parameter_node> &param);
-        llvm::Value* emit_function_call_node(const std::shared_ptr<ast::function_call_node> &call);
-        llvm::Value* emit_element_call_node(const std::shared_ptr<ast::element_call_node> &call);
-        llvm::Value* emit_member_invoke_node(const std::shared_ptr<ast::member_invoke_node> &member);
-        llvm::Value* emit_index_access_node(const std::shared_ptr<ast::index_access_node> &idx);
-        llvm::Value* emit_index_assignment_node(const std::shared_ptr<ast::index_assignment_node> &idx_assign);
-        llvm::Value* emit_if_node(const std::shared_ptr<ast::if_node> &ifstmt);
-        llvm::Value* emit_while_node(const std::shared_ptr<ast::while_node> &whilestmt);
-        llvm::Value* emit_switch_node(const std::shared_ptr<ast::switch_node> &sw);
-        llvm::Value* emit_case_node(const std::shared_ptr<ast::case_node> &case_stmt);
-        llvm::Value* emit_return_node(const std::shared_ptr<ast::return_node> &ret);
-        llvm::Value* emit_break_node(const std::shared_ptr<ast::break_node> &brk);
-        llvm::Value* emit_continue_node(const std::shared_ptr<ast::continue_node> &cont);
-        llvm::Value* emit_increment_node(const std::shared_ptr<ast::increment_node> &inc);
-        llvm::Value* emit_decrement_node(const std::shared_ptr<ast::decrement_node> &dec);
-        llvm::Value* emit_body_node(const std::shared_ptr<ast::body_node> &body);
-        llvm::Function* emit_function_node(const std::shared_ptr<ast::function_node> &func);
-        llvm::Function* emit_function_prototype_node(const std::shared_ptr<ast::function_prototype_node> &proto);
-        llvm::Value* emit_extern_node(const std::shared_ptr<ast::extern_node> &ext);
-
-        llvm::Type* get_llvm_type(const variable_type &vtype);
-        [[nodiscard]] llvm::Type* get_llvm_primitive_type(std::string_view base_type) const;
+        static std::string mangle_name(std::string_view base_name, std::span<const type_id> args);
+        static std::string_view mangle_type(type_id type);
+
+        llvm::Value* emit_node(const ast::base_node& node);
+        llvm::Value* emit_expression_node(const ast::expression_node& expr);
+        llvm::Value* emit_binary_node(const ast::binary_node& bin);
+        llvm::Value* emit_unary_node(const ast::unary_node& un);
+        llvm::Value* emit_literal_node(const ast::literal_node& lit);
+        llvm::Value* emit_string_literal_node(const ast::string_literal_node& str);
+        llvm::Value* emit_variable_node(const ast::variable_node& var);
+        llvm::Value* emit_variable_declaration_node(const ast::variable_declaration_node& decl);
+        llvm::Value* emit_variable_declaration_assign_node(const ast::variable_declaration_assign_node& decl_assign);
+        llvm::Value* emit_assignment_node(const ast::assignment_node& assign);
+        llvm::Value* emit_parameter_node(const ast::parameter_node& param);
+        llvm::Value* emit_function_call_node(const ast::function_call_node& call);
+        llvm::Value* emit_element_call_node(const ast::element_call_node& call);
+        llvm::Value* emit_member_invoke_node(const ast::member_invoke_node& member);
+        llvm::Value* emit_index_access_node(const ast::index_access_node& idx);
+        llvm::Value* emit_index_assignment_node(const ast::index_assignment_node& idx_assign);
+        llvm::Value* emit_if_node(const ast::if_node& ifstmt);
+        llvm::Value* emit_while_node(const ast::while_node& whilestmt);
+        llvm::Value* emit_switch_node(const ast::switch_node& sw);
+        llvm::Value* emit_case_node(const ast::case_node& case_stmt);
+        llvm::Value* emit_return_node(const ast::return_node& ret);
+        llvm::Value* emit_break_node(const ast::break_node& brk);
+        llvm::Value* emit_continue_node(const ast::continue_node& cont);
+        llvm::Value* emit_increment_node(const ast::increment_node& inc);
+        llvm::Value* emit_decrement_node(const ast::decrement_node& dec);
+        llvm::Value* emit_body_node(const ast::body_node& body);
+        llvm::Function* emit_function_node(const ast::function_node& func);
+        llvm::Function* emit_function_prototype_node(const ast::function_prototype_node& proto);
+        llvm::Value* emit_extern_node(const ast::extern_node& ext);
+
+        llvm::Type* get_llvm_type(type_id type);
+        [[nodiscard]] llvm::Type* get_llvm_primitive_type(primitive_type type) const;
         [[nodiscard]] llvm::Function* get_named_function(std::string_view name) const;
+        // Has to run on the whole program before the first call is emitted. Unused until the emit_*
+        // bodies land, which is where calls are resolved through these two.
+        void index_overloads(const ast::program_node& root);
+        // Function a call of `name`, or UFCS call on a first argument, with these argument types
+        // lands on; nullptr if nothing matches or it has not been emitted yet
+        llvm::Function* resolve_call(symbol_id name, std::span<const type_id> arguments);
+
+        // With `thin_bitcode`, stops at the ThinLTO pre-link pipeline and writes the module there
+        void optimize(llvm::raw_ostream* thin_bitcode = nullptr);
+        // Builds a machine for the current target and level, and points the module at it
+        void retarget();
+        // A target machine like m_target_machine, for a backend running on another thread
+        [[nodiscard]] std::unique_ptr<llvm::TargetMachine> create_target_machine() const;
 
         void push_scope();
         void pop_scope();
-        llvm::Value* get_variable_value(std::string_view name);
-        bool set_variable_value(std::string_view name, llvm::Value* value);
+        [[nodiscard]] llvm::Value* get_variable_value(symbol_id name) const;
+        bool set_variable_value(symbol_id name, llvm::Value* value);
 
         std::unique_ptr<llvm::LLVMContext> m_context;
         std::unique_ptr<llvm::Module> m_module;
         std::unique_ptr<llvm::IRBuilder<>> m_builder;
-        std::unique_ptr<llvm::Target> m_target;
+        // Owned by this codegen alone, the pass builder and the backend write to it
         std::unique_ptr<llvm::TargetMachine> m_target_machine;
 
-        std::vector<std::unordered_map<std::string, llvm::Value*>> m_symbol_stack;
-
-        std::string m_target_triple;
+        scoped_table<llvm::Value*> m_symbols;
+        std::optional<overload_index> m_overloads;
+        // Per overload, filled from the module on first use
+        std::vector<llvm::Function*> m_overload_functions;
+        // Indexed by type_id. LLVM types belong to m_context, so the cache lives here and not in the type table
+        std::vector<llvm::Type*> m_llvm_types;
+
+        target_options m_target_options;
+        opt_level m_opt_level = opt_level::O0;
+        bool m_time_passes = false;
+        profile_mode m_profile = profile_mode::None;
+        std::string m_profile_path;
     };
 
 } // ent
@@ -0,0 +1,195 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Document.hh"
+#include "Macro.hh"
+#include "Parser.hh"
+#include <algorithm>
+#include <span>
+
+namespace ent {
+    namespace {
+        bool is_definition(const lexer::token& tok) {
+            static const symbol_id define = symbol_table::intern("define");
+            return tok.type == lexer::token::TOKEN_TYPE::Identifier && tok.symbol == define;
+        }
+
+        size_t count_definitions(const std::span<const lexer::token> tokens) {
+            return static_cast<size_t>(std::ranges::count_if(tokens, is_definition));
+        }
+
+        bool same_token(const lexer::token& a, const lexer::token& b) {
+            return a.type == b.type && a.length == b.length && a.symbol == b.symbol;
+        }
+    }
+
+    document::document(std::string text) : m_text(std::move(text)) {
+        rebuild();
+    }
+
+    const std::string& document::text() const noexcept {
+        return m_text;
+    }
+
+    const std::vector<lexer::token>& document::tokens() const noexcept {
+        return m_tokens;
+    }
+
+    ast::base_node_ptr document::program() const {
+        return m_program;
+    }
+
+    void document::rebuild() {
+        m_stale = true;
+        m_arena.reset();
+        lexer lex{std::string_view(m_text)};
+        m_tokens = std::move(lex.get_tokens());
+        m_definitions = count_definitions(m_tokens);
+        m_declarations.clear();
+        m_nodes.clear();
+        if (m_definitions > 0) {
+            // Expansions do not map back onto source tokens, so there is nothing to reuse
+            macro_expander macros(m_tokens, lex.get_lines());
+            parser parser(std::move(macros.get_tokens()), std::move(lex.get_lines()), m_arena);
+            m_program = parser.parse_program();
+        } else {
+            std::vector<declaration> declarations;
+            std::vector<ast::base_node_ptr> nodes;
+            parse_declarations(0, 0, 0, 0, declarations, nodes);
+            m_declarations = std::move(declarations);
+            m_nodes = std::move(nodes);
+            m_program = m_arena.make<ast::program_node>(ast::node_list(m_nodes));
+        }
+        m_rebuilt_size = m_arena.used();
+        m_stale = false;
+    }
+
+    void document::edit(const size_t offset, const size_t removed, const std::string_view inserted) {
+        if (offset > m_text.size() || removed > m_text.size() - offset) {
+            throw document_error(std::format("Edit of {} characters at {} is outside the buffer of {}", removed, offset, m_text.size()));
+        }
+        m_text.replace(offset, removed, inserted);
+        // Replaced declarations stay in the arena, once they outweigh the live tree start over
+        if (m_stale || m_definitions > 0 || m_arena.used() > 2 * m_rebuilt_size) {
+            rebuild();
+            return;
+        }
+        // Until both passes went through the tokens and declarations may not agree with the text
+        m_stale = true;
+        const std::ptrdiff_t shift = static_cast<std::ptrdiff_t>(inserted.size()) - static_cast<std::ptrdiff_t>(removed);
+
+        auto [first, last, fresh] = relex(offset, removed, shift);
+        m_definitions += count_definitions(fresh);
+        m_definitions -= count_definitions(std::span(m_tokens).subspan(first, last - first));
+        const std::ptrdiff_t token_shift = static_cast<std::ptrdiff_t>(fresh.size()) - static_cast<std::ptrdiff_t>(last - first);
+
+        const auto tail = m_tokens.erase(m_tokens.begin() + first, m_tokens.begin() + last);
+        m_tokens.insert(tail, fresh.begin(), fresh.end());
+        const size_t resynced = first + fresh.size();
+        for (size_t i = resynced; i < m_tokens.size(); ++i) {
+            m_tokens[i].offset = static_cast<std::uint32_t>(m_tokens[i].offset + shift);
+        }
+        // The lexer started fresh at `first`, and what precedes the first reused token has changed
+        m_tokens[first].first_on_line = starts_line(first);
+        if (resynced < m_tokens.size()) {
+            m_tokens[resynced].first_on_line = starts_line(resynced);
+        }
+
+        if (m_definitions > 0) {
+            rebuild();
+            return;
+        }
+
+        // Declarations are contiguous, so the first one that reaches `first` is the first one to redo.
+        // One that ends right at `first` is redone as well, its parse may have looked at that token.
+        const auto damaged = std::ranges::partition_point(m_declarations, [first](const declaration& d) { return d.end < first; });
+        const size_t candidate = damaged - m_declarations.begin();
+        const size_t begin = damaged != m_declarations.end() ? damaged->begin : m_declarations.empty() ? 0 : m_declarations.back().end;
+
+        std::vector<declaration> declarations;
+        std::vector<ast::base_node_ptr> nodes;
+        const size_t kept = parse_declarations(begin, candidate, last, token_shift, declarations, nodes);
+
+        for (size_t i = kept; i < m_declarations.size(); ++i) {
+            m_declarations[i].begin += token_shift;
+            m_declarations[i].end += token_shift;
+        }
+        m_declarations.erase(m_declarations.begin() + candidate, m_declarations.begin() + kept);
+        m_declarations.insert(m_declarations.begin() + candidate, declarations.begin(), declarations.end());
+        m_nodes.erase(m_nodes.begin() + candidate, m_nodes.begin() + kept);
+        m_nodes.insert(m_nodes.begin() + candidate, nodes.begin(), nodes.end());
+        m_program = m_arena.make<ast::program_node>(ast::node_list(m_nodes));
+        m_stale = false;
+    }
+
+    document::damage document::relex(const size_t offset, const size_t removed, const std::ptrdiff_t shift) const {
+        // Tokens that end before the edit are untouched, but the last of them may grow into it
+        // (an identifier typed onto), so lexing restarts at its beginning
+        const auto touched = std::ranges::partition_point(m_tokens, [offset](const lexer::token& t) { return t.offset + t.length < offset; });
+        size_t first = touched - m_tokens.begin();
+        first = first > 0 ? first - 1 : 0;
+        const size_t from = first > 0 ? m_tokens[first].offset : 0;
+        const std::int64_t edit_end = static_cast<std::int64_t>(offset + removed);
+
+        damage result{first, first, {}};
+        lexer lex(std::string_view(m_text).substr(from), lexer::streaming);
+        // The lexer only sees the text from `from` on, its errors have to point into the whole buffer
+        const auto pull = [&lex, from] {
+            try {
+                return lex.pull();
+            } catch (const lexer_out_of_range& e) {
+                throw lexer_out_of_range(e.index() + from, e.limit() + from);
+            }
+        };
+        while (true) {
+            lexer::token tok = pull();
+            tok.offset += static_cast<std::uint32_t>(from);
+            // Old tokens that begin inside the edit, or now lie behind the new token, can't line up any more
+            const auto moved = [&](const size_t i) { return static_cast<std::int64_t>(m_tokens[i].offset) + shift; };
+            while (result.last < m_tokens.size() &&
+                   (static_cast<std::int64_t>(m_tokens[result.last].offset) < edit_end || moved(result.last) < tok.offset)) {
+                ++result.last;
+            }
+            // Lexing a token depends on nothing but the text from its start, so once a new token
+            // matches an old one past the edit everything after it matches as well
+            if (result.last < m_tokens.size() && moved(result.last) == tok.offset && same_token(m_tokens[result.last], tok)) {
+                return result;
+            }
+            result.tokens.push_back(tok);
+            if (tok.type == lexer::token::TOKEN_TYPE::EOFToken) {
+                result.last = m_tokens.size();
+                return result;
+            }
+        }
+    }
+
+    size_t document::parse_declarations(const size_t begin, size_t candidate, const size_t resync, const std::ptrdiff_t shift,
+                                        std::vector<declaration>& declarations, std::vector<ast::base_node_ptr>& nodes) {
+        parser parser([this, next = begin]() mutable { return m_tokens[std::min(next++, m_tokens.size() - 1)]; },
+                      line_index(std::vector<std::string_view>{m_text}), m_arena);
+        while (true) {
+            const size_t position = begin + parser.consumed();
+            const auto moved = [&](const size_t i) { return static_cast<size_t>(static_cast<std::ptrdiff_t>(m_declarations[i].begin) + shift); };
+            while (candidate < m_declarations.size() && (m_declarations[candidate].begin < resync || moved(candidate) < position)) {
+                ++candidate;
+            }
+            if (candidate < m_declarations.size() && moved(candidate) == position) {
+                return candidate;
+            }
+            ast::base_node_ptr node = parser.parse_declaration();
+            if (!node) {
+                return m_declarations.size();
+            }
+            declarations.push_back({position, begin + parser.consumed()});
+            nodes.push_back(std::move(node));
+        }
+    }
+
+    bool document::starts_line(const size_t index) const {
+        if (index == 0) {
+            return true;
+        }
+        const size_t from = m_tokens[index - 1].offset;
+        return std::string_view(m_text).substr(from, m_tokens[index].offset - from).find('\n') != std::string_view::npos;
+    }
+}
@@ -0,0 +1,76 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef DOCUMENT_HH
+#define DOCUMENT_HH
+
+#include "AST.icc"
+#include "Error.hh"
+#include "Lexer.hh"
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ent {
+    class document_error final : public error {
+    public:
+        explicit document_error(const std::string_view msg) : error(msg) {}
+    };
+
+    // A buffer that stays lexed and parsed across edits, for editors. An edit re-lexes from the token
+    // before it until the new tokens line up with the old ones again, then re-parses only the
+    // top-level declarations that contain changed tokens; every other declaration keeps its node.
+    //
+    // The text is what the lexer sees, so include lines and header blocks must already be resolved by
+    // the preprocessor. A buffer that defines macros is rebuilt in full on every edit.
+    class document {
+    public:
+        explicit document(std::string text);
+
+        // Replaces `removed` characters at `offset` with `inserted`. If lexing or parsing the new text
+        // fails the error propagates and the next edit rebuilds everything.
+        void edit(size_t offset, size_t removed, std::string_view inserted);
+
+        [[nodiscard]] const std::string& text() const noexcept;
+        [[nodiscard]] const std::vector<lexer::token>& tokens() const noexcept;
+        // Valid until the next edit
+        [[nodiscard]] ast::base_node_ptr program() const;
+
+    private:
+        // Token range [begin, end) a top-level declaration was parsed from
+        struct declaration {
+            size_t begin;
+            size_t end;
+        };
+
+        // Tokens [first, last) of the old token stream were replaced by `tokens`
+        struct damage {
+            size_t first;
+            size_t last;
+            std::vector<lexer::token> tokens;
+        };
+
+        void rebuild();
+        [[nodiscard]] damage relex(size_t offset, size_t removed, std::ptrdiff_t shift) const;
+        // Parses declarations from token `begin` until the parser reaches the start of an old
+        // declaration at or after token `resync` (old index, moved by `shift` tokens), or the end.
+        // Returns the index of the first old declaration that can be kept.
+        size_t parse_declarations(size_t begin, size_t candidate, size_t resync, std::ptrdiff_t shift,
+                                  std::vector<declaration>& declarations, std::vector<ast::base_node_ptr>& nodes);
+        [[nodiscard]] bool starts_line(size_t index) const;
+
+        std::string m_text;
+        std::vector<lexer::token> m_tokens;
+        // Holds the nodes of every declaration parsed since the last rebuild, replaced ones included
+        arena m_arena;
+        size_t m_rebuilt_size = 0;
+        std::vector<declaration> m_declarations;
+        std::vector<ast::base_node_ptr> m_nodes;
+        ast::base_node_ptr m_program;
+        size_t m_definitions = 0;
+        bool m_stale = true;
+    };
+}
+
+#endif //DOCUMENT_HH
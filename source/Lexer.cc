@@ -3,59 +3,178 @@
 //
 
 #include "Lexer.hh"
-#include <map>
-#include <cctype>
+#include <algorithm>
+#include <array>
 
 namespace ent {
 
-    static const std::map<std::string_view, lexer::token::TOKEN_TYPE> keywords = {
-        {"fn", lexer::token::TOKEN_TYPE::Function},
-        {"return", lexer::token::TOKEN_TYPE::Return},
-        {"extern", lexer::token::TOKEN_TYPE::Extern},
-        {"void", lexer::token::TOKEN_TYPE::Void},
-        {"typedef", lexer::token::TOKEN_TYPE::Typedef},
-        {"struct", lexer::token::TOKEN_TYPE::Struct},
-        {"if", lexer::token::TOKEN_TYPE::If},
-        {"else", lexer::token::TOKEN_TYPE::Else},
-        {"while", lexer::token::TOKEN_TYPE::While},
-        {"switch", lexer::token::TOKEN_TYPE::Switch},
-        {"case", lexer::token::TOKEN_TYPE::Case},
-        {"default", lexer::token::TOKEN_TYPE::Default},
-        {"break", lexer::token::TOKEN_TYPE::Break},
-        {"continue", lexer::token::TOKEN_TYPE::Continue},
-        {"sbyte", lexer::token::TOKEN_TYPE::SByte},
-        {"sword", lexer::token::TOKEN_TYPE::SWord},
-        {"sdword", lexer::token::TOKEN_TYPE::SDWord},
-        {"sqword", lexer::token::TOKEN_TYPE::SQWord},
-        {"byte", lexer::token::TOKEN_TYPE::Byte},
-        {"word", lexer::token::TOKEN_TYPE::Word},
-        {"dword", lexer::token::TOKEN_TYPE::DWord},
-        {"qword", lexer::token::TOKEN_TYPE::QWord},
-    };
+    namespace {
+        using TOKEN_TYPE = lexer::token::TOKEN_TYPE;
+
+        struct keyword {
+            std::string_view text;
+            TOKEN_TYPE type;
+            // what token::to_string() reports
+            std::string_view name;
+        };
+
+        constexpr keyword keywords[] = {
+            {"fn", TOKEN_TYPE::Function, "Function"},
+            {"return", TOKEN_TYPE::Return, "Return"},
+            {"extern", TOKEN_TYPE::Extern, "Extern"},
+            {"void", TOKEN_TYPE::Void, "Void"},
+            {"typedef", TOKEN_TYPE::Typedef, "Typedef"},
+            {"struct", TOKEN_TYPE::Struct, "Struct"},
+            {"if", TOKEN_TYPE::If, "If"},
+            {"else", TOKEN_TYPE::Else, "Else"},
+            {"while", TOKEN_TYPE::While, "While"},
+            {"switch", TOKEN_TYPE::Switch, "Switch"},
+            {"case", TOKEN_TYPE::Case, "Case"},
+            {"default", TOKEN_TYPE::Default, "Default"},
+            {"break", TOKEN_TYPE::Break, "Break"},
+            {"continue", TOKEN_TYPE::Continue, "Continue"},
+            {"sbyte", TOKEN_TYPE::SByte, "SByte"},
+            {"sword", TOKEN_TYPE::SWord, "SWord"},
+            {"sdword", TOKEN_TYPE::SDWord, "SDWord"},
+            {"sqword", TOKEN_TYPE::SQWord, "SQWord"},
+            {"byte", TOKEN_TYPE::Byte, "Byte"},
+            {"word", TOKEN_TYPE::Word, "Word"},
+            {"dword", TOKEN_TYPE::DWord, "DWord"},
+            {"qword", TOKEN_TYPE::QWord, "QWord"},
+        };
+        constexpr std::size_t keyword_count = std::size(keywords);
+
+        constexpr std::size_t max_keyword_length = std::ranges::max(keywords, {}, [](const keyword& k) { return k.text.size(); }).text.size();
+
+        // Perfect hash over the keyword list: the seed is searched for at compile time so that every
+        // keyword lands in its own slot, a lookup is one hash, one load and one compare.
+        constexpr unsigned keyword_table_bits = 6;
+        constexpr std::size_t keyword_table_size = std::size_t{1} << keyword_table_bits;
+
+        constexpr std::uint32_t keyword_hash(const std::string_view text, const std::uint32_t seed) {
+            std::uint32_t hash = seed ^ static_cast<std::uint32_t>(text.size());
+            for (const char c : text) {
+                hash = (hash ^ static_cast<unsigned char>(c)) * 0x01000193u;
+            }
+            return hash >> (32 - keyword_table_bits);
+        }
+
+        constexpr std::uint32_t find_keyword_seed() {
+            for (std::uint32_t seed = 1;; ++seed) {
+                std::array<bool, keyword_table_size> used{};
+                bool perfect = true;
+                for (const keyword& k : keywords) {
+                    bool& slot = used[keyword_hash(k.text, seed)];
+                    if (slot) {
+                        perfect = false;
+                        break;
+                    }
+                    slot = true;
+                }
+                if (perfect) {
+                    return seed;
+                }
+            }
+        }
+
+        constexpr std::uint32_t keyword_seed = find_keyword_seed();
+
+        // Slot -> index into keywords, keyword_count for an empty slot
+        constexpr auto keyword_slots = [] {
+            std::array<std::uint8_t, keyword_table_size> slots{};
+            slots.fill(keyword_count);
+            for (std::size_t i = 0; i < keyword_count; ++i) {
+                slots[keyword_hash(keywords[i].text, keyword_seed)] = static_cast<std::uint8_t>(i);
+            }
+            return slots;
+        }();
+
+        constexpr const keyword* find_keyword(const std::string_view text) {
+            if (text.size() > max_keyword_length) {
+                return nullptr;
+            }
+            const std::uint8_t index = keyword_slots[keyword_hash(text, keyword_seed)];
+            return index != keyword_count && keywords[index].text == text ? &keywords[index] : nullptr;
+        }
+
+        static_assert(std::ranges::all_of(keywords, [](const keyword& k) { return find_keyword(k.text) == &k; }));
+        static_assert(find_keyword("fnx") == nullptr && find_keyword("") == nullptr);
+
+        // Character classes, independent of the current locale
+        enum char_class : std::uint8_t {
+            Digit = 1 << 0,
+            HexDigit = 1 << 1,
+            Letter = 1 << 2,
+            Underscore = 1 << 3,
+            IdentifierStart = Letter | Underscore,
+        };
+
+        constexpr auto char_classes = [] {
+            std::array<std::uint8_t, 256> classes{};
+            for (int c = '0'; c <= '9'; ++c) { classes[c] |= Digit | HexDigit; }
+            for (int c = 'a'; c <= 'z'; ++c) { classes[c] |= Letter; }
+            for (int c = 'A'; c <= 'Z'; ++c) { classes[c] |= Letter; }
+            for (int c = 'a'; c <= 'f'; ++c) { classes[c] |= HexDigit; }
+            for (int c = 'A'; c <= 'F'; ++c) { classes[c] |= HexDigit; }
+            classes['_'] |= Underscore;
+            return classes;
+        }();
+
+        constexpr bool is(const char c, const std::uint8_t classes) {
+            return (char_classes[static_cast<unsigned char>(c)] & classes) != 0;
+        }
+    }
+
+    line_index::line_index(std::vector<std::string_view> spans) : m_spans(std::move(spans)) {}
+
+    void line_index::add_line(const std::uint32_t start) {
+        m_line_starts.push_back(start);
+    }
+
+    source_position line_index::position(const std::uint32_t offset) const {
+        if (!m_spans.empty()) {
+            int line = 1;
+            std::uint32_t line_start = 0;
+            std::uint32_t base = 0;
+            for (const std::string_view span : m_spans) {
+                if (base >= offset) {
+                    break;
+                }
+                for (size_t pos = span.find('\n'); pos != std::string_view::npos && base + pos < offset; pos = span.find('\n', pos + 1)) {
+                    ++line;
+                    line_start = base + static_cast<std::uint32_t>(pos) + 1;
+                }
+                base += static_cast<std::uint32_t>(span.size());
+            }
+            return {line, static_cast<int>(offset - line_start) + 1};
+        }
+        const auto line = std::ranges::upper_bound(m_line_starts, offset) - m_line_starts.begin();
+        return {static_cast<int>(line), static_cast<int>(offset - m_line_starts[line - 1]) + 1};
+    }
+
+    int line_index::line(const std::uint32_t offset) const {
+        if (!m_spans.empty()) {
+            return position(offset).line;
+        }
+        return static_cast<int>(std::ranges::upper_bound(m_line_starts, offset) - m_line_starts.begin());
+    }
+
+    std::string_view lexer::token::value() const {
+        return symbol_table::name(symbol);
+    }
 
     [[nodiscard]] std::string_view lexer::token::to_string() const {
+        static constexpr auto keyword_names = [] {
+            std::array<std::string_view, static_cast<std::size_t>(TOKEN_TYPE::EOFToken) + 1> names{};
+            for (const keyword& k : keywords) {
+                names[static_cast<std::size_t>(k.type)] = k.name;
+            }
+            return names;
+        }();
+        if (const std::string_view name = keyword_names[static_cast<std::size_t>(type)]; !name.empty()) {
+            return name;
+        }
         switch (type) {
-            case TOKEN_TYPE::Function: return "Function";
-            case TOKEN_TYPE::Return: return "Return";
-            case TOKEN_TYPE::Extern: return "Extern";
-            case TOKEN_TYPE::Void: return "Void";
-            case TOKEN_TYPE::Typedef: return "Typedef";
-            case TOKEN_TYPE::Struct: return "Struct";
-            case TOKEN_TYPE::If: return "If";
-            case TOKEN_TYPE::Else: return "Else";
-            case TOKEN_TYPE::While: return "While";
-            case TOKEN_TYPE::Switch: return "Switch";
-            case TOKEN_TYPE::Case: return "Case";
-            case TOKEN_TYPE::Default: return "Default";
-            case TOKEN_TYPE::Break: return "Break";
-            case TOKEN_TYPE::Continue: return "Continue";
-            case TOKEN_TYPE::SByte: return "SByte";
-            case TOKEN_TYPE::SWord: return "SWord";
-            case TOKEN_TYPE::SDWord: return "SDWord";
-            case TOKEN_TYPE::QWord: return "QWord";
-            case TOKEN_TYPE::Byte: return "Byte";
-            case TOKEN_TYPE::Word: return "Word";
-            case TOKEN_TYPE::DWord: return "DWord";
             case TOKEN_TYPE::Identifier: return "identifier";
             case TOKEN_TYPE::Decimal: return "decimal_number";
             case TOKEN_TYPE::Binary: return "binary_number";
@@ -87,6 +206,8 @@ namespace ent {
             case TOKEN_TYPE::Ampersand: return "ampersand";
             case TOKEN_TYPE::Slash: return "slash";
             case TOKEN_TYPE::Pipe: return "pipe";
+            case TOKEN_TYPE::LogicalAnd: return "logical_and";
+            case TOKEN_TYPE::LogicalOr: return "logical_or";
             case TOKEN_TYPE::Exclamation: return "exclamation";
             case TOKEN_TYPE::EOFToken: return "eof_token";
             default: return "<unknown>";
@@ -120,6 +241,8 @@ namespace ent {
             case TOKEN_TYPE::Ampersand: return '&';
             case TOKEN_TYPE::Slash: return '/';
             case TOKEN_TYPE::Pipe: return '|';
+            case TOKEN_TYPE::LogicalAnd: return L'&';
+            case TOKEN_TYPE::LogicalOr: return L'|';
             case TOKEN_TYPE::Exclamation: return '!';
             case TOKEN_TYPE::EOFToken: return '\n';
             default: return '\0';
@@ -166,78 +289,228 @@ namespace ent {
     }
 
     void lexer::add_token(const token::TOKEN_TYPE type, const std::string_view value) {
-        if (value.empty()) {
-            m_tokens.emplace_back(type, m_line, m_column);
-        } else {
-            m_tokens.emplace_back(type, value, m_line, m_column);
+        push_token(type, value.empty() ? 0 : symbol_table::intern(value));
+    }
+
+    void lexer::push_token(const token::TOKEN_TYPE type, const symbol_id symbol) {
+        note_newlines(m_start);
+        const std::int64_t offset = m_base + m_start;
+        token& tok = m_tokens.emplace_back(type, static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(m_current - m_start), symbol);
+        tok.first_on_line = m_last_newline >= m_previous_offset;
+        m_previous_offset = offset;
+    }
+
+    // Remembers the last newline in m_source[m_scanned, end), every character is looked at once
+    void lexer::note_newlines(const size_t end) {
+        if (end <= m_scanned) {
+            return;
         }
+        if (const size_t pos = m_source.substr(m_scanned, end - m_scanned).rfind('\n'); pos != std::string_view::npos) {
+            m_last_newline = m_base + m_scanned + pos;
+        }
+        m_scanned = end;
     }
 
-    lexer::lexer(const std::string_view preprocessed_file) : m_source(preprocessed_file) {
-        m_tokens.reserve(m_source.size() / 4);
-        while (m_current < m_source.size()) {
-            skip_whitespace();
-            m_start = m_current;
-            if (m_current >= m_source.size()) break;
-
-            const char c = next();
-            switch (c) {
-                case '(': add_token(token::TOKEN_TYPE::LeftParen); break;
-                case ')': add_token(token::TOKEN_TYPE::RightParen); break;
-                case '{': add_token(token::TOKEN_TYPE::LeftBrace); break;
-                case '}': add_token(token::TOKEN_TYPE::RightBrace); break;
-                case '[': add_token(token::TOKEN_TYPE::LeftBracket); break;
-                case ']': add_token(token::TOKEN_TYPE::RightBracket); break;
-                case ',': add_token(token::TOKEN_TYPE::Comma); break;
-                case '.': add_token(token::TOKEN_TYPE::Period); break;
-                case ';': add_token(token::TOKEN_TYPE::Semicolon); break;
-                case '&': add_token(token::TOKEN_TYPE::Ampersand); break;
-                case '|': add_token(token::TOKEN_TYPE::Pipe); break;
-                case '*': add_token(token::TOKEN_TYPE::Star); break;
-                case ':': add_token(token::TOKEN_TYPE::Colon); break;
-                case '/': handle_slash(); break;
-                case '=':
-                    if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::Equal); }
-                    else { add_token(token::TOKEN_TYPE::Assign); }
-                    break;
-                case '!':
-                    if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::NotEqual); }
-                    else { add_token(token::TOKEN_TYPE::Exclamation); }
-                    break;
-                case '<':
-                    if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::LessEqual); }
-                    else { add_token(token::TOKEN_TYPE::Less); }
-                    break;
-                case '>':
-                    if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::GreaterEqual); }
-                    else { add_token(token::TOKEN_TYPE::Greater); }
-                    break;
-                case '+':
-                    if (peak() == '+') { next(); add_token(token::TOKEN_TYPE::Increment); }
-                    else { add_token(token::TOKEN_TYPE::Plus); }
-                    break;
-                case '-':
-                    if (peak() == '-') { next(); add_token(token::TOKEN_TYPE::Decrement); }
-                    else { add_token(token::TOKEN_TYPE::Minus); }
-                    break;
-                case '\'': handle_character_literal(); break;
-                case '"': handle_string_literal(); break;
-                default:
-                    if (std::isdigit(c)) { handle_number(); }
-                    else if (std::isalpha(c) || c == '_') {
-                        if (!handle_keyword()) { handle_identifier(); }
-                    } else {
-                        throw lexer_expected_error("valid symbol or expression", std::string(1, c));
-                    }
+    void lexer::index_lines(const std::string_view span, const std::uint32_t base) {
+        for (size_t pos = span.find('\n'); pos != std::string_view::npos; pos = span.find('\n', pos + 1)) {
+            m_lines.add_line(base + static_cast<std::uint32_t>(pos) + 1);
+        }
+    }
+
+    lexer::lexer(const std::string_view preprocessed_file) : m_spans{preprocessed_file} {
+        m_tokens.reserve(preprocessed_file.size() / 4);
+        while (lex_step()) {}
+        finish();
+    }
+
+    lexer::lexer(const source_rope& preprocessed_file) : m_spans(preprocessed_file.spans()) {
+        m_tokens.reserve(preprocessed_file.size() / 4);
+        while (lex_step()) {}
+        finish();
+    }
+
+    lexer::lexer(const std::string_view preprocessed_file, streaming_t) : m_spans{preprocessed_file}, m_index_lines(false) {}
+
+    lexer::lexer(const source_rope& preprocessed_file, streaming_t) : m_spans(preprocessed_file.spans()), m_index_lines(false) {}
+
+    lexer::token lexer::pull() {
+        if (!m_tokens.empty() && m_tokens.back().type == token::TOKEN_TYPE::EOFToken) {
+            return m_tokens.back();
+        }
+        m_tokens.clear();
+        if (!lex_step()) {
+            finish();
+        }
+        return m_tokens.back();
+    }
+
+    // Lexes until one more token has been produced, false once the input is exhausted.
+    // Spans end on line boundaries, so only a block comment or string literal can run into the
+    // next span. That token alone is copied out and re-lexed together with as much of the next
+    // span as it needs, then lexing goes back to reading the span in place.
+    bool lexer::lex_step() {
+        const size_t produced = m_tokens.size();
+        while (m_tokens.size() == produced) {
+            if (m_current >= m_source.size()) {
+                note_newlines(m_source.size());
+                if (!next_span()) {
+                    return false;
+                }
+                continue;
+            }
+            try {
+                lex_one();
+            } catch (const lexer_out_of_range&) {
+                if (!carry_token()) {
+                    throw;
+                }
+                continue;
+            }
+            if (!m_carry.empty() && m_current >= m_carry_prefix) {
+                resume_span();
             }
         }
-        add_token(token::TOKEN_TYPE::EOFToken);
+        return true;
+    }
+
+    bool lexer::next_span() {
+        if (m_next_span == m_spans.size()) {
+            return false;
+        }
+        m_span = m_spans[m_next_span++];
+        if (m_index_lines) {
+            index_lines(m_span, m_span_base);
+        }
+        m_source = m_span;
+        m_base = m_span_base;
+        m_span_base += static_cast<std::uint32_t>(m_span.size());
+        m_current = 0;
+        m_scanned = 0;
+        return true;
+    }
+
+    // Copies the token cut off at m_start into m_carry and appends more of the spans after it,
+    // doubling the amount each time the token still does not end; false at the end of the input
+    bool lexer::carry_token() {
+        note_newlines(m_start);
+        if (m_carry.empty() || m_carry_taken == m_span.size()) {
+            if (m_next_span == m_spans.size()) {
+                return false;
+            }
+            std::string rest(m_source.substr(m_start));
+            const std::uint32_t base = m_base + static_cast<std::uint32_t>(m_start);
+            next_span();
+            m_carry = std::move(rest);
+            m_carry_prefix = m_carry.size();
+            m_carry_taken = 0;
+            m_base = base;
+        } else {
+            m_carry.erase(0, m_start);
+            m_carry_prefix -= m_start;
+            m_base += static_cast<std::uint32_t>(m_start);
+        }
+        const size_t take = std::min(m_span.size() - m_carry_taken, std::max<size_t>(m_carry_taken, 64));
+        m_carry.append(m_span.substr(m_carry_taken, take));
+        m_carry_taken += take;
+        m_source = m_carry;
+        m_start = m_current = m_scanned = 0;
+        return true;
+    }
+
+    // The carried token is done and ends inside m_span, continue from there in place
+    void lexer::resume_span() {
+        note_newlines(m_current);
+        const size_t resume = m_current - m_carry_prefix;
+        m_carry.clear();
+        m_source = m_span;
+        m_base = m_span_base - static_cast<std::uint32_t>(m_span.size());
+        m_current = m_scanned = resume;
+    }
+
+    void lexer::finish() {
+        m_source = std::string_view();
+        m_base = m_span_base;
+        m_start = m_current = m_scanned = 0;
+        push_token(token::TOKEN_TYPE::EOFToken, 0);
+    }
+
+    void lexer::lex_one() {
+        skip_whitespace();
+        m_start = m_current;
+        if (m_current >= m_source.size()) return;
+
+        const char c = next();
+        switch (c) {
+            case '(': add_token(token::TOKEN_TYPE::LeftParen); break;
+            case ')': add_token(token::TOKEN_TYPE::RightParen); break;
+            case '{': add_token(token::TOKEN_TYPE::LeftBrace); break;
+            case '}': add_token(token::TOKEN_TYPE::RightBrace); break;
+            case '[': add_token(token::TOKEN_TYPE::LeftBracket); break;
+            case ']': add_token(token::TOKEN_TYPE::RightBracket); break;
+            case ',': add_token(token::TOKEN_TYPE::Comma); break;
+            case '.': add_token(token::TOKEN_TYPE::Period); break;
+            case ';': add_token(token::TOKEN_TYPE::Semicolon); break;
+            case '&':
+                if (peak() == '&') { next(); add_token(token::TOKEN_TYPE::LogicalAnd); }
+                else { add_token(token::TOKEN_TYPE::Ampersand); }
+                break;
+            case '|':
+                if (peak() == '|') { next(); add_token(token::TOKEN_TYPE::LogicalOr); }
+                else { add_token(token::TOKEN_TYPE::Pipe); }
+                break;
+            case '*': add_token(token::TOKEN_TYPE::Star); break;
+            case ':': add_token(token::TOKEN_TYPE::Colon); break;
+            case '/': handle_slash(); break;
+            case '=':
+                if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::Equal); }
+                else { add_token(token::TOKEN_TYPE::Assign); }
+                break;
+            case '!':
+                if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::NotEqual); }
+                else { add_token(token::TOKEN_TYPE::Exclamation); }
+                break;
+            case '<':
+                if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::LessEqual); }
+                else { add_token(token::TOKEN_TYPE::Less); }
+                break;
+            case '>':
+                if (peak() == '=') { next(); add_token(token::TOKEN_TYPE::GreaterEqual); }
+                else { add_token(token::TOKEN_TYPE::Greater); }
+                break;
+            case '+':
+                if (peak() == '+') { next(); add_token(token::TOKEN_TYPE::Increment); }
+                else { add_token(token::TOKEN_TYPE::Plus); }
+                break;
+            case '-':
+                if (peak() == '-') { next(); add_token(token::TOKEN_TYPE::Decrement); }
+                else { add_token(token::TOKEN_TYPE::Minus); }
+                break;
+            case '\'': handle_character_literal(); break;
+            case '"': handle_string_literal(); break;
+            default:
+                if (is(c, Digit)) { handle_number(); }
+                else if (is(c, IdentifierStart)) {
+                    if (!handle_keyword()) { handle_identifier(); }
+                } else {
+                    throw lexer_expected_error("valid symbol or expression", std::string(1, c));
+                }
+        }
     }
 
     std::vector<lexer::token>& lexer::get_tokens() {
         return m_tokens;
     }
 
+    line_index& lexer::get_lines() {
+        return m_lines;
+    }
+
+    token_source vector_source(std::vector<lexer::token> tokens) {
+        return [tokens = std::move(tokens), next = size_t{0}]() mutable {
+            return next < tokens.size() ? tokens[next++] : tokens.back();
+        };
+    }
+
     void lexer::handle_character_literal() {
         const char c = next();
         std::string value;
@@ -256,39 +529,60 @@ namespace ent {
         add_token(token::TOKEN_TYPE::CharacterLiteral, value);
     }
 
+    size_t lexer::scan_with(const char* (*kernel)(const char*, const char*)) const {
+        return kernel(m_source.data() + m_current, m_source.data() + m_source.size()) - m_source.data();
+    }
+
     bool lexer::handle_keyword() {
-        while (std::isalnum(peak()) || peak() == '_') { next(); }
+        skip_identifier();
         const std::string_view text = m_source.substr(m_start, m_current - m_start);
-        if (keywords.contains(text)) {
-            add_token(keywords.at(text), text);
+        // Keyword spellings are interned once up front
+        static const auto keyword_symbols = [] {
+            std::array<symbol_id, keyword_count> symbols{};
+            for (std::size_t i = 0; i < keyword_count; ++i) {
+                symbols[i] = symbol_table::intern(keywords[i].text);
+            }
+            return symbols;
+        }();
+        if (const keyword* match = find_keyword(text)) {
+            push_token(match->type, keyword_symbols[match - keywords]);
             return true;
         }
         return false;
     }
 
+    void lexer::skip_identifier() {
+        m_current = scan_with(m_scan.skip_identifier);
+        if (m_current >= m_source.size()) {
+            throw lexer_out_of_range(m_current, m_source.size());
+        }
+    }
+
     void lexer::handle_identifier() {
-        while (std::isalnum(peak()) || peak() == '_') { next(); }
+        skip_identifier();
         add_token(token::TOKEN_TYPE::Identifier, m_source.substr(m_start, m_current - m_start));
     }
 
     void lexer::handle_string_literal() {
         std::string value;
-        while (peak() != '"' && m_current < m_source.size()) {
-            if (peak() == '\\') {
-                next();
-                switch (next()) {
-                    case 'n': value += '\n'; break;
-                    case 't': value += '\t'; break;
-                    case '\\': value += '\\'; break;
-                    case '"': value += '"'; break;
-                    default: throw lexer_expected_error("valid escape sequence", std::string(1, peak()));
-                }
-            } else {
-                value += next();
+        while (true) {
+            const size_t run_end = scan_with(m_scan.find_string_special);
+            value.append(m_source.substr(m_current, run_end - m_current));
+            m_current = run_end;
+            if (m_current >= m_source.size()) {
+                throw lexer_out_of_range(m_current, m_source.size());
+            }
+            if (m_source[m_current] == '"') {
+                break;
+            }
+            next();
+            switch (next()) {
+                case 'n': value += '\n'; break;
+                case 't': value += '\t'; break;
+                case '\\': value += '\\'; break;
+                case '"': value += '"'; break;
+                default: throw lexer_expected_error("valid escape sequence", std::string(1, peak()));
             }
-        }
-        if (m_current >= m_source.size()) {
-            throw lexer_out_of_range(m_current, m_source.size());
         }
         match('"');
         add_token(token::TOKEN_TYPE::StringLiteral, value);
@@ -306,66 +600,52 @@ namespace ent {
     }
 
     void lexer::skip_line_comment() {
-        while (peak() != '\n' && m_current < m_source.size()) { next(); }
-        if (peak() == '\n') {
-            next();
-            m_line++;
-            m_column = 1;
-        }
+        m_current = scan_with(m_scan.find_newline);
+        match('\n');
     }
 
     void lexer::skip_block_comment() {
-        while (!(peak() == '*' && peak(1) == '/') && m_current < m_source.size()) { next(); }
-        if (m_current >= m_source.size()) {
-            throw lexer_out_of_range(m_current, m_source.size());
+        while (true) {
+            m_current = scan_with(m_scan.find_star);
+            if (m_current + 1 >= m_source.size()) {
+                throw lexer_out_of_range(m_current + 1, m_source.size());
+            }
+            if (m_source[m_current + 1] == '/') {
+                m_current += 2;
+                return;
+            }
+            ++m_current;
         }
-        match('*');
-        match('/');
     }
 
     void lexer::skip_whitespace() {
-        while (m_current < m_source.size()) {
-            switch (peak()) {
-                case ' ': case '\r': case '\t':
-                    next();
-                    m_column++;
-                    break;
-                case '\n':
-                    next();
-                    m_line++;
-                    m_column = 1;
-                    break;
-                default:
-                    return;
-            }
-        }
+        m_current = scan_with(m_scan.skip_whitespace);
     }
 
     void lexer::handle_number() {
-        std::string number;
         if (previous() == '0') {
             const char c = peak();
             if (c == 'b') {
                 next();
-                while (std::isdigit(peak()) && (peak() == '0' || peak() == '1')) { number += next(); }
-                add_token(token::TOKEN_TYPE::Binary, number);
+                while (peak() == '0' || peak() == '1') { next(); }
+                add_token(token::TOKEN_TYPE::Binary, m_source.substr(m_start + 2, m_current - m_start - 2));
                 return;
             }
             if (c == 'x') {
                 next();
-                while (std::isxdigit(peak())) { number += next(); }
-                add_token(token::TOKEN_TYPE::Hexadecimal, number);
+                while (is(peak(), HexDigit)) { next(); }
+                add_token(token::TOKEN_TYPE::Hexadecimal, m_source.substr(m_start + 2, m_current - m_start - 2));
                 return;
             }
-            if (!std::isalnum(c)) {
+            if (!is(c, Letter | Digit)) {
                 add_token(token::TOKEN_TYPE::Decimal, "0");
                 return;
             }
 
             throw lexer_expected_error("binary or hexadecimal number prefix", std::string(1, c));
         }
-        while (std::isdigit(peak())) { number += next(); }
-        add_token(token::TOKEN_TYPE::Decimal, number);
+        while (is(peak(), Digit)) { next(); }
+        add_token(token::TOKEN_TYPE::Decimal, m_source.substr(m_start, m_current - m_start));
     }
 
 } // namespace ent
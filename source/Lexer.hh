@@ -6,6 +6,11 @@
 #define LEXER_HH
 
 #include "Error.hh"
+#include "Rope.hh"
+#include "Scan.hh"
+#include "Symbol.hh"
+#include <cstdint>
+#include <functional>
 #include <string_view>
 #include <string>
 #include <vector>
@@ -17,16 +22,46 @@ namespace ent {
     };
     class lexer_out_of_range final : public lexer_error {
     public:
-        explicit lexer_out_of_range(const size_t index, const size_t limit) : lexer_error(std::format("Out of range access to {}, limit is {}\n", index, limit)) {}
+        explicit lexer_out_of_range(const size_t index, const size_t limit)
+            : lexer_error(std::format("Out of range access to {}, limit is {}\n", index, limit)), m_index(index), m_limit(limit) {}
+        [[nodiscard]] size_t index() const noexcept { return m_index; }
+        [[nodiscard]] size_t limit() const noexcept { return m_limit; }
+    private:
+        size_t m_index;
+        size_t m_limit;
     };
     class lexer_expected_error final : public lexer_error {
     public:
         explicit lexer_expected_error(const std::string_view expected, const std::string_view got) : lexer_error(std::format("Expected {}, but got {}!\n", expected, got)) {}
     };
+
+    struct source_position {
+        int line;
+        int column;
+    };
+
+    // Offsets at which every line of the lexed source starts, for turning token offsets into
+    // 1-based line and column numbers only when somebody asks for them.
+    class line_index {
+    public:
+        line_index() = default;
+        // Records nothing and rescans `spans` on every lookup instead, for streaming where memory
+        // must not grow with the input and positions are only needed for diagnostics
+        explicit line_index(std::vector<std::string_view> spans);
+
+        void add_line(std::uint32_t start);
+        [[nodiscard]] source_position position(std::uint32_t offset) const;
+        [[nodiscard]] int line(std::uint32_t offset) const;
+
+    private:
+        std::vector<std::uint32_t> m_line_starts{0};
+        std::vector<std::string_view> m_spans;
+    };
+
     class lexer {
     public:
         struct token {
-            enum class TOKEN_TYPE {
+            enum class TOKEN_TYPE : std::uint8_t {
                 Identifier,
                 Function, Return, Struct, Typedef, If, Else, While, Switch, Case, Default, Break, Continue, Extern,
                 Void, Byte, Word, DWord, QWord, SByte, SWord, SDWord, SQWord,
@@ -51,24 +86,52 @@ namespace ent {
                 Star, Ampersand,
                 Slash,
                 Pipe,
+                LogicalAnd, LogicalOr,      // && ||
                 Exclamation,
                 EOFToken
             };
+            // Where the token was lexed from, resolve through the lexer's line_index
+            std::uint32_t offset;
+            std::uint32_t length;
+            // Interned text of identifiers, keywords and literals (decoded), 0 for punctuation
+            symbol_id symbol;
             TOKEN_TYPE type;
-            std::string value;
-            int line, column;
-            token(const TOKEN_TYPE type, const std::string_view value, const int line, const int column) : type(type), value(value), line(line), column(column) {}
-            token(const TOKEN_TYPE type, const int line, const int column) : type(type), line(line), column(column) {}
+            // No token precedes it on its line
+            bool first_on_line = false;
+            token(const TOKEN_TYPE type, const std::uint32_t offset, const std::uint32_t length, const symbol_id symbol = 0)
+                : offset(offset), length(length), symbol(symbol), type(type) {}
 
+            [[nodiscard]] std::string_view value() const;
             [[nodiscard]] std::string_view to_string() const;
             [[nodiscard]] wchar_t to_symbol() const;
 
             bool operator==(const token& other) const;
             bool operator!=(const token& other) const;
         };
+        // Tag for a lexer that produces tokens one at a time through pull() instead of all up front
+        struct streaming_t {};
+        static constexpr streaming_t streaming{};
+
         explicit lexer(std::string_view preprocessed_file);
+        explicit lexer(const source_rope& preprocessed_file);
+        lexer(std::string_view preprocessed_file, streaming_t);
+        lexer(const source_rope& preprocessed_file, streaming_t);
         std::vector<token>& get_tokens();
+        line_index& get_lines();
+        // Next token of a streaming lexer, the EOF token once the input is exhausted
+        token pull();
     private:
+        [[nodiscard]] bool lex_step();
+        bool next_span();
+        bool carry_token();
+        void resume_span();
+        void lex_one();
+        void finish();
+        void note_newlines(size_t end);
+        void push_token(token::TOKEN_TYPE type, symbol_id symbol);
+        // Runs one of the scan kernels from m_current, returning the index it stopped at
+        [[nodiscard]] size_t scan_with(const char* (*kernel)(const char*, const char*)) const;
+        void index_lines(std::string_view span, std::uint32_t base);
         char next();
         [[nodiscard]] char previous() const;
         [[nodiscard]] char peak(size_t index = 0) const;
@@ -83,15 +146,41 @@ namespace ent {
         void skip_line_comment();
         void skip_block_comment();
         void skip_whitespace();
+        void skip_identifier();
         void handle_slash();
 
+        std::vector<std::string_view> m_spans;
+        size_t m_next_span = 0;
+        std::uint32_t m_span_base = 0;
+        // The span m_source reads, or the one the carried token runs into
+        std::string_view m_span;
+        // A token running into the next span is re-lexed from a copy of it followed by the first
+        // m_carry_taken bytes of m_span, which start at m_carry[m_carry_prefix]
+        std::string m_carry;
+        size_t m_carry_prefix = 0;
+        size_t m_carry_taken = 0;
+        bool m_index_lines = true;
+
         std::string_view m_source;
+        // Offset of m_source[0] within the whole lexed text
+        std::uint32_t m_base = 0;
         std::vector<token> m_tokens;
+        line_index m_lines;
         size_t m_current = 0;
         size_t m_start = 0;
-        int m_line = 0;
-        int m_column = 0;
+        // For first_on_line: the last newline before m_start and where the previous token began
+        std::int64_t m_last_newline = -1;
+        std::int64_t m_previous_offset = -1;
+        size_t m_scanned = 0;
+        const scan::kernels& m_scan = scan::active();
     };
+
+    static_assert(sizeof(lexer::token) <= 16, "tokens are meant to stay compact");
+
+    // Pull-based token producer: every call returns the next token, and the EOF token forever once
+    // the input is exhausted
+    using token_source = std::function<lexer::token()>;
+    token_source vector_source(std::vector<lexer::token> tokens);
 } // ent
 
 #endif //LEXER_HH
@@ -0,0 +1,93 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Link.hh"
+#include <llvm/LTO/LTO.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Threading.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <format>
+#include <mutex>
+#include <ranges>
+#include <unordered_set>
+#include <utility>
+
+namespace ent {
+    std::vector<std::string> thin_link(const std::span<const std::string> inputs, const std::string_view stem,
+                                       const opt_level level, const unsigned threads, const target_options& target) {
+        target_cache::initialize();
+        llvm::lto::Config config;
+        config.CPU = target.cpu;
+        for (const auto feature : std::views::split(target.features, ',')) {
+            if (!feature.empty()) {
+                config.MAttrs.emplace_back(feature.begin(), feature.end());
+            }
+        }
+        config.OptLevel = level == opt_level::Os ? 2 : static_cast<unsigned>(level);
+        config.CGOptLevel = codegen_opt_level(level);
+        config.RelocModel = llvm::Reloc::PIC_;
+        llvm::lto::LTO lto(std::move(config), llvm::lto::createInProcessThinBackend(llvm::heavyweight_hardware_concurrency(threads)));
+
+        // InputFile points into its buffer, so the buffers outlive the link
+        std::vector<std::unique_ptr<llvm::MemoryBuffer>> buffers;
+        std::unordered_set<std::string> defined;
+        for (const std::string& input : inputs) {
+            llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer = llvm::MemoryBuffer::getFile(input);
+            if (!buffer) {
+                throw link_error(std::format("{}: {}", input, buffer.getError().message()));
+            }
+            llvm::Expected<std::unique_ptr<llvm::lto::InputFile>> file = llvm::lto::InputFile::create((*buffer)->getMemBufferRef());
+            if (!file) {
+                throw link_error(std::format("{}: {}", input, llvm::toString(file.takeError())));
+            }
+            buffers.push_back(std::move(*buffer));
+
+            // The first definition of a name wins, as with a regular link
+            std::vector<llvm::lto::SymbolResolution> resolutions;
+            for (const llvm::lto::InputFile::Symbol& symbol : (*file)->symbols()) {
+                llvm::lto::SymbolResolution& resolution = resolutions.emplace_back();
+                if (symbol.isUndefined()) {
+                    continue;
+                }
+                resolution.Prevailing = defined.insert(symbol.getName().str()).second;
+                resolution.FinalDefinitionInLinkageUnit = resolution.Prevailing;
+                resolution.VisibleToRegularObj = symbol.getName() == "main";
+            }
+            if (llvm::Error error = lto.add(std::move(*file), resolutions)) {
+                throw link_error(std::format("{}: {}", input, llvm::toString(std::move(error))));
+            }
+        }
+
+        // Backends call back from their own threads, and only for tasks that produce code. An error
+        // returned here stops that backend and comes back out of run().
+        std::mutex mutex;
+        // Task and file, sorted by task at the end, since "stem.10.o" sorts before "stem.2.o" as a string
+        std::vector<std::pair<unsigned, std::string>> written;
+        const auto add_stream = [&](const unsigned task, const llvm::Twine&)
+            -> llvm::Expected<std::unique_ptr<llvm::CachedFileStream>> {
+            std::string filename = std::format("{}.{}.o", stem, task);
+            std::error_code EC;
+            auto stream = std::make_unique<llvm::raw_fd_ostream>(filename, EC, llvm::sys::fs::OF_None);
+            if (EC) {
+                return llvm::createStringError(EC, "%s: %s", filename.c_str(), EC.message().c_str());
+            }
+            {
+                const std::scoped_lock lock(mutex);
+                written.emplace_back(task, filename);
+            }
+            return std::make_unique<llvm::CachedFileStream>(std::move(stream), std::move(filename));
+        };
+        if (llvm::Error error = lto.run(add_stream)) {
+            throw link_error(llvm::toString(std::move(error)));
+        }
+        std::ranges::sort(written, {}, &std::pair<unsigned, std::string>::first);
+        std::vector<std::string> objects;
+        objects.reserve(written.size());
+        for (auto& [task, filename] : written) {
+            objects.push_back(std::move(filename));
+        }
+        return objects;
+    }
+}
@@ -0,0 +1,30 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef LINK_HH
+#define LINK_HH
+
+#include "Codegen.hh"
+#include "Error.hh"
+#include "Target.hh"
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ent {
+    class link_error final : public error {
+    public:
+        explicit link_error(const std::string_view msg) : error(std::format("Link failed: {}", msg)) {}
+    };
+
+    // ThinLTO link over files written by codegen::write_thin_bitcode. Reads every module summary,
+    // imports the callees worth inlining from other modules, then optimizes and emits each module on
+    // its own thread as <stem>.<n>.o. Only main stays visible, everything else may be internalized.
+    // Returns the objects written, for the system linker.
+    std::vector<std::string> thin_link(std::span<const std::string> inputs, std::string_view stem, opt_level level,
+                                       unsigned threads, const target_options& target = {});
+}
+
+#endif //LINK_HH
@@ -0,0 +1,261 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Macro.hh"
+#include <algorithm>
+
+namespace ent {
+    macro_expander::macro_expander(token_source upstream, const line_index& lines)
+        : m_upstream(std::move(upstream)), m_lines(lines) {}
+
+    macro_expander::macro_expander(std::vector<lexer::token> tokens, const line_index& lines)
+        : m_upstream(vector_source(std::move(tokens))), m_lines(lines) {
+        do {
+            m_tokens.push_back(pull());
+        } while (m_tokens.back().type != lexer::token::TOKEN_TYPE::EOFToken);
+    }
+
+    std::vector<lexer::token>& macro_expander::get_tokens() {
+        return m_tokens;
+    }
+
+    lexer::token macro_expander::next_input() {
+        if (m_lookahead) {
+            const lexer::token tok = *m_lookahead;
+            m_lookahead.reset();
+            return tok;
+        }
+        return m_upstream();
+    }
+
+    lexer::token macro_expander::pull() {
+        static const symbol_id define = symbol_table::intern("define");
+        while (m_pending_next == m_pending.size()) {
+            m_pending.clear();
+            m_pending_next = 0;
+
+            const lexer::token tok = next_input();
+            // Definitions only count at the start of a line, same as the preprocessor directives
+            if (tok.type == lexer::token::TOKEN_TYPE::Identifier && tok.symbol == define && tok.first_on_line) {
+                parse_define(tok);
+                continue;
+            }
+            std::vector<const macro*> active;
+            const macro* definition = find_macro(tok, active);
+            if (!definition) {
+                return tok;
+            }
+
+            // Buffer just the invocation, NAME or NAME( ... ) up to the matching ')'
+            std::vector<lexer::token> invocation{tok};
+            if (definition->function_like) {
+                int depth = 0;
+                do {
+                    invocation.push_back(next_input());
+                    const auto type = invocation.back().type;
+                    if (type == lexer::token::TOKEN_TYPE::LeftParen) {
+                        ++depth;
+                    } else if (type == lexer::token::TOKEN_TYPE::RightParen) {
+                        --depth;
+                    } else if (type == lexer::token::TOKEN_TYPE::EOFToken) {
+                        break;
+                    }
+                } while (depth > 0);
+                if (invocation.size() == 2 && invocation.back().type != lexer::token::TOKEN_TYPE::LeftParen) {
+                    m_lookahead = invocation.back();
+                    invocation.pop_back();
+                }
+            }
+            expand_invocation(*definition, invocation, 0, m_pending, active);
+        }
+        return m_pending[m_pending_next++];
+    }
+
+    // define NAME tokens...  or  define NAME(a, b) tokens...
+    // The definition runs until the end of the line it started on.
+    void macro_expander::parse_define(const lexer::token& define) {
+        const int line = m_lines.line(define.offset);
+        lexer::token tok = next_input();
+        const auto on_line = [&tok] {
+            return tok.type != lexer::token::TOKEN_TYPE::EOFToken && !tok.first_on_line;
+        };
+
+        if (!on_line() || tok.type != lexer::token::TOKEN_TYPE::Identifier) {
+            throw macro_error("Expected macro name after 'define'", line);
+        }
+        macro definition;
+        definition.name = tok.symbol;
+        tok = next_input();
+
+        if (on_line() && tok.type == lexer::token::TOKEN_TYPE::LeftParen) {
+            definition.function_like = true;
+            tok = next_input();
+            if (on_line() && tok.type == lexer::token::TOKEN_TYPE::RightParen) {
+                tok = next_input();
+            } else {
+                while (true) {
+                    if (!on_line() || tok.type != lexer::token::TOKEN_TYPE::Identifier) {
+                        throw macro_error(std::format("Expected parameter name in definition of macro '{}'", symbol_table::name(definition.name)), line);
+                    }
+                    definition.parameters.push_back(tok.symbol);
+                    tok = next_input();
+                    if (on_line() && tok.type == lexer::token::TOKEN_TYPE::Comma) {
+                        tok = next_input();
+                    } else if (on_line() && tok.type == lexer::token::TOKEN_TYPE::RightParen) {
+                        tok = next_input();
+                        break;
+                    } else {
+                        throw macro_error(std::format("Expected ',' or ')' in definition of macro '{}'", symbol_table::name(definition.name)), line);
+                    }
+                }
+            }
+        }
+
+        while (on_line()) {
+            definition.body.push_back(tok);
+            tok = next_input();
+        }
+        // The first token of the next line
+        m_lookahead = tok;
+
+        // Earlier expansions may have seen the old definition
+        m_memo.clear();
+        const symbol_id name = definition.name;
+        m_macros.insert_or_assign(name, std::move(definition));
+    }
+
+    const macro_expander::macro* macro_expander::find_macro(const lexer::token& tok, const std::vector<const macro*>& active) const {
+        if (tok.type != lexer::token::TOKEN_TYPE::Identifier || m_macros.empty()) {
+            return nullptr;
+        }
+        const auto it = m_macros.find(tok.symbol);
+        if (it == m_macros.end() || std::ranges::find(active, &it->second) != active.end()) {
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    void macro_expander::expand(const std::span<const lexer::token> input, std::vector<lexer::token>& out, std::vector<const macro*>& active) {
+        size_t i = 0;
+        while (i < input.size()) {
+            if (const macro* definition = find_macro(input[i], active)) {
+                i = expand_invocation(*definition, input, i, out, active);
+            } else {
+                out.push_back(input[i++]);
+            }
+        }
+    }
+
+    size_t macro_expander::expand_invocation(const macro& definition, const std::span<const lexer::token> input, const size_t index,
+                                             std::vector<lexer::token>& out, std::vector<const macro*>& active) {
+        const lexer::token& call = input[index];
+        size_t next = index + 1;
+
+        std::vector<std::span<const lexer::token>> arguments;
+        if (definition.function_like) {
+            if (next >= input.size() || input[next].type != lexer::token::TOKEN_TYPE::LeftParen) {
+                // The name of a function-like macro on its own is left alone
+                out.push_back(call);
+                return next;
+            }
+            next = collect_arguments(definition, input, next, arguments);
+        }
+
+        const std::string key = memo_key(definition, arguments, active);
+        auto it = m_memo.find(key);
+        if (it == m_memo.end()) {
+            std::vector<lexer::token> substituted;
+            if (definition.function_like) {
+                // Arguments are fully expanded before they are substituted
+                std::vector<std::vector<lexer::token>> expanded_arguments(arguments.size());
+                for (size_t a = 0; a < arguments.size(); ++a) {
+                    expand(arguments[a], expanded_arguments[a], active);
+                }
+                for (const lexer::token& tok : definition.body) {
+                    const auto param = tok.type == lexer::token::TOKEN_TYPE::Identifier
+                                           ? std::ranges::find(definition.parameters, tok.symbol)
+                                           : definition.parameters.end();
+                    if (param != definition.parameters.end()) {
+                        const auto& argument = expanded_arguments[param - definition.parameters.begin()];
+                        substituted.insert(substituted.end(), argument.begin(), argument.end());
+                    } else {
+                        substituted.push_back(tok);
+                    }
+                }
+            }
+
+            std::vector<lexer::token> expansion;
+            active.push_back(&definition);
+            expand(definition.function_like ? std::span<const lexer::token>(substituted) : std::span<const lexer::token>(definition.body),
+                   expansion, active);
+            active.pop_back();
+            it = m_memo.insert_or_assign(key, std::move(expansion)).first;
+        }
+
+        // Expanded tokens report the position of the invocation
+        for (const lexer::token& tok : it->second) {
+            out.push_back(tok);
+            out.back().offset = call.offset;
+            out.back().length = call.length;
+        }
+        return next;
+    }
+
+    // Splits NAME( ... ) at top-level commas, `index` points at the '('; returns the index after the ')'
+    size_t macro_expander::collect_arguments(const macro& definition, const std::span<const lexer::token> input, const size_t index,
+                                             std::vector<std::span<const lexer::token>>& arguments) const {
+        int depth = 0;
+        size_t start = index + 1;
+        for (size_t i = index; i < input.size(); ++i) {
+            switch (input[i].type) {
+                case lexer::token::TOKEN_TYPE::LeftParen:
+                    ++depth;
+                    break;
+                case lexer::token::TOKEN_TYPE::Comma:
+                    if (depth == 1) {
+                        arguments.push_back(input.subspan(start, i - start));
+                        start = i + 1;
+                    }
+                    break;
+                case lexer::token::TOKEN_TYPE::RightParen:
+                    if (--depth == 0) {
+                        arguments.push_back(input.subspan(start, i - start));
+                        if (definition.parameters.empty() && arguments.size() == 1 && arguments.front().empty()) {
+                            arguments.clear();
+                        }
+                        if (arguments.size() != definition.parameters.size()) {
+                            throw macro_error(std::format("Macro '{}' expects {} arguments, got {}", symbol_table::name(definition.name),
+                                                          definition.parameters.size(), arguments.size()),
+                                              m_lines.line(input[index].offset));
+                        }
+                        return i + 1;
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        throw macro_error(std::format("Unterminated invocation of macro '{}'", symbol_table::name(definition.name)),
+                          m_lines.line(input[index].offset));
+    }
+
+    std::string macro_expander::memo_key(const macro& definition, const std::vector<std::span<const lexer::token>>& arguments,
+                                         const std::vector<const macro*>& active) {
+        // Raw ids, tokens are equal exactly when their type and symbol are
+        std::string key;
+        const auto put = [&key](const auto value) { key.append(reinterpret_cast<const char*>(&value), sizeof(value)); };
+        put(definition.name);
+        put(static_cast<symbol_id>(active.size()));
+        for (const macro* m : active) {
+            put(m->name);
+        }
+        for (const auto& argument : arguments) {
+            put(static_cast<symbol_id>(argument.size()));
+            for (const lexer::token& tok : argument) {
+                put(tok.type);
+                put(tok.symbol);
+            }
+        }
+        return key;
+    }
+}
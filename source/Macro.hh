@@ -0,0 +1,71 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef MACRO_HH
+#define MACRO_HH
+
+#include "Error.hh"
+#include "Lexer.hh"
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ent {
+    class macro_error final : public error {
+    public:
+        macro_error(const std::string_view msg, const int line)
+            : error(std::format("{} at line {}", msg, line)) {}
+    };
+
+    // Token stream stage between the lexer and the parser. A line starting with
+    //   define NAME tokens...
+    //   define NAME(a, b) tokens...
+    // defines an object-like or function-like macro; the definition is removed from the stream and
+    // every later use is replaced by its expansion. Expansions are rescanned for further macros,
+    // a macro is never expanded inside its own expansion, and the result of every invocation is
+    // memoized, so repeated uses of the same macro with the same arguments expand only once.
+    // Tokens are pulled from upstream as they are needed, only a pending invocation is buffered.
+    class macro_expander {
+    public:
+        macro_expander(token_source upstream, const line_index& lines);
+        // Expands the whole stream up front, get_tokens() returns the result
+        macro_expander(std::vector<lexer::token> tokens, const line_index& lines);
+        std::vector<lexer::token>& get_tokens();
+        lexer::token pull();
+
+    private:
+        struct macro {
+            symbol_id name = 0;
+            std::vector<symbol_id> parameters;
+            std::vector<lexer::token> body;
+            bool function_like = false;
+        };
+
+        lexer::token next_input();
+        void parse_define(const lexer::token& define);
+        void expand(std::span<const lexer::token> input, std::vector<lexer::token>& out, std::vector<const macro*>& active);
+        size_t expand_invocation(const macro& definition, std::span<const lexer::token> input, size_t index,
+                                 std::vector<lexer::token>& out, std::vector<const macro*>& active);
+        size_t collect_arguments(const macro& definition, std::span<const lexer::token> input, size_t index,
+                                 std::vector<std::span<const lexer::token>>& arguments) const;
+        static std::string memo_key(const macro& definition, const std::vector<std::span<const lexer::token>>& arguments,
+                                    const std::vector<const macro*>& active);
+        [[nodiscard]] const macro* find_macro(const lexer::token& tok, const std::vector<const macro*>& active) const;
+
+        std::unordered_map<symbol_id, macro> m_macros;
+        std::unordered_map<std::string, std::vector<lexer::token>> m_memo;
+        std::vector<lexer::token> m_tokens;
+        token_source m_upstream;
+        std::optional<lexer::token> m_lookahead;
+        // Expansion of the last invocation, handed out by pull() one token at a time
+        std::vector<lexer::token> m_pending;
+        size_t m_pending_next = 0;
+        const line_index& m_lines;
+    };
+}
+
+#endif //MACRO_HH
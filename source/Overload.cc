@@ -0,0 +1,71 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Overload.hh"
+#include <algorithm>
+#include <format>
+
+namespace ent {
+    std::string mangle_function(const std::string_view name, const std::span<const type_id> parameters) {
+        std::string mangled = std::format("_E{}{}", name.length(), name);
+        for (const type_id parameter : parameters) {
+            mangled += type_table::mangled(parameter);
+        }
+        return mangled;
+    }
+
+    overload_index::overload_index(const ast::program_node& program) {
+        for (const ast::base_node_ptr element : program.m_elements) {
+            if (const auto* function = ast::node_cast<ast::function_node>(element)) {
+                add(function->m_name, function->m_return_type, function->m_parameters, false);
+            } else if (const auto* prototype = ast::node_cast<ast::function_prototype_node>(element)) {
+                add(prototype->m_name, prototype->m_return_type, prototype->m_parameters, false);
+            } else if (const auto* external = ast::node_cast<ast::extern_node>(element)) {
+                if (const auto* foreign = ast::node_cast<ast::function_prototype_node>(external->m_child)) {
+                    add(foreign->m_name, foreign->m_return_type, foreign->m_parameters, true);
+                }
+            }
+        }
+    }
+
+    void overload_index::add(const symbol_id name, const type_id return_type, const ast::node_list parameters, const bool is_extern) {
+        std::vector<type_id> types;
+        types.reserve(parameters.size());
+        for (const ast::base_node_ptr parameter : parameters) {
+            types.push_back(ast::node_cast<ast::parameter_node>(parameter)->m_type);
+        }
+        static const symbol_id entry_point = symbol_table::intern("main");
+        std::string symbol = is_extern || name == entry_point ? std::string(symbol_table::name(name)) : mangle_function(symbol_table::name(name), types);
+
+        const auto index = static_cast<std::uint32_t>(m_overloads.size());
+        if (!m_by_symbol.try_emplace(symbol, index).second) {
+            return;
+        }
+        const type_id first = types.empty() ? no_parameters : types.front();
+        m_by_first[key(name, first)].push_back(index);
+        m_overloads.push_back({name, return_type, std::move(types), std::move(symbol), is_extern});
+    }
+
+    std::span<const std::uint32_t> overload_index::candidates(const symbol_id name, const type_id first) const {
+        const auto found = m_by_first.find(key(name, first));
+        return found != m_by_first.end() ? std::span<const std::uint32_t>(found->second) : std::span<const std::uint32_t>();
+    }
+
+    std::int64_t overload_index::resolve(const symbol_id name, const std::span<const type_id> arguments) const {
+        // Types are interned, so matching a signature is comparing ids
+        for (const std::uint32_t index : candidates(name, arguments.empty() ? no_parameters : arguments.front())) {
+            if (std::ranges::equal(m_overloads[index].parameters, arguments)) {
+                return index;
+            }
+        }
+        return -1;
+    }
+
+    const overload& overload_index::operator[](const std::uint32_t index) const {
+        return m_overloads[index];
+    }
+
+    size_t overload_index::size() const noexcept {
+        return m_overloads.size();
+    }
+}
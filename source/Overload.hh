@@ -0,0 +1,63 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef OVERLOAD_HH
+#define OVERLOAD_HH
+
+#include "AST.icc"
+#include "Symbol.hh"
+#include "Type.hh"
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ent {
+    // _E<length><name> followed by the mangled suffix of every parameter type
+    std::string mangle_function(std::string_view name, std::span<const type_id> parameters);
+
+    struct overload {
+        symbol_id name;
+        type_id return_type;
+        std::vector<type_id> parameters;
+        // Symbol the function has in the module: mangled, except for externs and main
+        std::string symbol;
+        bool is_extern;
+    };
+
+    // Every function a module declares, indexed by name and first parameter type, so a call or a UFCS
+    // call `a.f(b)` (which is f(a, b)) finds its candidates with one hash lookup. Built once per
+    // module, and every symbol name is mangled up front rather than at each call site.
+    class overload_index {
+    public:
+        // First parameter type of a function that takes none
+        static constexpr type_id no_parameters = ~type_id{0};
+
+        explicit overload_index(const ast::program_node& program);
+
+        // Functions called `name` whose first parameter is `first`, in declaration order
+        [[nodiscard]] std::span<const std::uint32_t> candidates(symbol_id name, type_id first) const;
+        // Index of the function taking exactly `arguments`, -1 if there is none
+        [[nodiscard]] std::int64_t resolve(symbol_id name, std::span<const type_id> arguments) const;
+
+        [[nodiscard]] const overload& operator[](std::uint32_t index) const;
+        [[nodiscard]] size_t size() const noexcept;
+
+    private:
+        void add(symbol_id name, type_id return_type, ast::node_list parameters, bool is_extern);
+
+        static std::uint64_t key(const symbol_id name, const type_id first) noexcept {
+            return static_cast<std::uint64_t>(name) << 32 | first;
+        }
+
+        std::vector<overload> m_overloads;
+        std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> m_by_first;
+        // A prototype and the definition it announces are one function
+        std::unordered_map<std::string, std::uint32_t> m_by_symbol;
+    };
+}
+
+#endif //OVERLOAD_HH
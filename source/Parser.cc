@@ -1,11 +1,81 @@
 #include "Parser.hh"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <tuple>
 
 namespace ent {
+    namespace {
+        using TOKEN_TYPE = lexer::token::TOKEN_TYPE;
+
+        struct operator_info {
+            // How tightly the token binds as a binary operator, 0 if it is not one
+            int precedence = 0;
+            ast::EXPRESSION_NODE_OP op{};
+            // Makes a unary_node when it starts an operand
+            bool prefix = false;
+        };
+
+        struct binary_operator {
+            TOKEN_TYPE token;
+            int precedence;
+            ast::EXPRESSION_NODE_OP op;
+        };
+
+        // A new binary operator is one more line here, the parser needs no new code
+        constexpr binary_operator binary_operators[] = {
+            {TOKEN_TYPE::LogicalOr, 1, ast::EXPRESSION_NODE_OP::LOGICAL_OR},
+            {TOKEN_TYPE::LogicalAnd, 2, ast::EXPRESSION_NODE_OP::LOGICAL_AND},
+            {TOKEN_TYPE::Equal, 3, ast::EXPRESSION_NODE_OP::EQUAL},
+            {TOKEN_TYPE::NotEqual, 3, ast::EXPRESSION_NODE_OP::NOT_EQUAL},
+            {TOKEN_TYPE::Less, 4, ast::EXPRESSION_NODE_OP::LESS},
+            {TOKEN_TYPE::LessEqual, 4, ast::EXPRESSION_NODE_OP::LESS_EQUAL},
+            {TOKEN_TYPE::Greater, 4, ast::EXPRESSION_NODE_OP::GREATER},
+            {TOKEN_TYPE::GreaterEqual, 4, ast::EXPRESSION_NODE_OP::GREATER_EQUAL},
+            {TOKEN_TYPE::Plus, 5, ast::EXPRESSION_NODE_OP::ADDITION},
+            {TOKEN_TYPE::Minus, 5, ast::EXPRESSION_NODE_OP::SUBTRACTION},
+            {TOKEN_TYPE::Star, 6, ast::EXPRESSION_NODE_OP::MULTIPLICATION},
+            {TOKEN_TYPE::Slash, 6, ast::EXPRESSION_NODE_OP::DIVISION},
+        };
+
+        constexpr TOKEN_TYPE prefix_operators[] = {
+            TOKEN_TYPE::Minus, TOKEN_TYPE::Plus, TOKEN_TYPE::Exclamation, TOKEN_TYPE::Ampersand, TOKEN_TYPE::Star,
+        };
+
+        // Indexed by token type, so classifying the current token is one load
+        constexpr auto operator_table = [] {
+            std::array<operator_info, static_cast<size_t>(TOKEN_TYPE::EOFToken) + 1> table{};
+            for (const auto& [token, precedence, op] : binary_operators) {
+                table[static_cast<size_t>(token)].precedence = precedence;
+                table[static_cast<size_t>(token)].op = op;
+            }
+            for (const TOKEN_TYPE token : prefix_operators) {
+                table[static_cast<size_t>(token)].prefix = true;
+            }
+            return table;
+        }();
+
+        static_assert(operator_table[static_cast<size_t>(TOKEN_TYPE::EOFToken)].precedence == 0,
+                      "the end of input must stop every operator loop");
+        static_assert(static_cast<int>(TOKEN_TYPE::SQWord) - static_cast<int>(TOKEN_TYPE::Void) == static_cast<int>(primitive_type::SQWord),
+                      "type keywords have to follow primitive_type");
+    }
+
+    parser::nesting_guard::nesting_guard(parser& owner) : m_owner(owner) {
+        if (++m_owner.m_nesting > max_nesting) {
+            m_owner.error(m_owner.current(), "Expression nested too deeply.");
+        }
+    }
+
+    parser::nesting_guard::~nesting_guard() {
+        --m_owner.m_nesting;
+    }
+
     const lexer::token& parser::peek(const size_t offset) const {
-        if (m_current + offset < m_tokens.size()) {
-            return m_tokens[m_current + offset];
+        while (m_pulled <= m_current + offset) {
+            m_window[m_pulled++ % window_size] = m_source();
         }
-        return m_tokens.back();
+        return m_window[(m_current + offset) % window_size];
     }
 
     const lexer::token& parser::current() const {
@@ -13,7 +83,7 @@ namespace ent {
     }
 
     const lexer::token& parser::previous() const {
-        return m_tokens[m_current - 1];
+        return m_window[(m_current - 1) % window_size];
     }
 
     bool parser::match(const lexer::token::TOKEN_TYPE type) {
@@ -41,8 +111,9 @@ namespace ent {
         error(current(), std::format("{} got: {}", message, peek().to_string()));
     }
 
-    [[noreturn]] void parser::error(const lexer::token& tok, const std::string_view message) {
-        throw parser_error(std::string(message), tok.line, tok.column);
+    [[noreturn]] void parser::error(const lexer::token& tok, const std::string_view message) const {
+        const auto [line, column] = m_lines.position(tok.offset);
+        throw parser_error(std::string(message), line, column);
     }
 
     bool parser::is_at_end() const {
@@ -50,13 +121,126 @@ namespace ent {
     }
 
     ast::base_node_ptr parser::parse_program() {
-        std::vector<ast::base_node_ptr> elements;
+        const size_t elements = m_scratch.size();
 
         while (!is_at_end()) {
-            elements.push_back(parse_top_level_decl());
+            m_scratch.push_back(parse_top_level_decl());
+        }
+
+        return m_nodes.make<ast::program_node>(take_list(elements));
+    }
+
+    ast::base_node_ptr parser::parse_program_parallel(std::vector<lexer::token> tokens, line_index lines,
+                                                      arena& nodes, thread_pool& pool) {
+        const std::vector<size_t> ends = declaration_ends(tokens);
+        // Everything but the trailing EOF token has to be covered by declarations
+        const size_t total = tokens.size() - 1;
+        if (pool.size() == 0 || total < min_parallel_tokens || ends.empty() || ends.back() != total) {
+            return parser(std::move(tokens), std::move(lines), nodes).parse_program();
+        }
+
+        // A few batches per thread so a run of long functions does not leave the others idle
+        struct batch {
+            size_t first;
+            size_t last;
+            arena nodes;
+            std::vector<ast::base_node_ptr> declarations;
+            bool lined_up = false;
+        };
+        const size_t target = std::max<size_t>(min_batch_tokens, total / (4 * (pool.size() + 1)));
+        std::vector<std::pair<size_t, size_t>> ranges;
+        for (size_t first = 0, last = 0; last < ends.size(); ++last) {
+            const size_t begin = first == 0 ? 0 : ends[first - 1];
+            if (ends[last] - begin >= target || last + 1 == ends.size()) {
+                ranges.emplace_back(first, last + 1);
+                first = last + 1;
+            }
         }
+        const auto batches = std::make_unique<batch[]>(ranges.size());
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            batch& b = batches[i];
+            std::tie(b.first, b.last) = ranges[i];
+            pool.submit([&tokens, &ends, &b] {
+                const size_t begin = b.first == 0 ? 0 : ends[b.first - 1];
+                const size_t end = ends[b.last - 1];
+                // Positions only matter for errors, and an error sends everything back to the sequential parse
+                parser part([&tokens, next = begin, end]() mutable { return tokens[next < end ? next++ : tokens.size() - 1]; },
+                            line_index(), b.nodes);
+                b.declarations.reserve(b.last - b.first);
+                try {
+                    for (size_t d = b.first; d < b.last; ++d) {
+                        b.declarations.push_back(part.parse_declaration());
+                        if (begin + part.consumed() != ends[d]) {
+                            return;
+                        }
+                    }
+                } catch (const ent::error&) {
+                    return;
+                }
+                b.lined_up = true;
+            });
+        }
+        pool.wait();
 
-        return std::make_shared<ast::program_node>(std::move(elements));
+        if (!std::all_of(batches.get(), batches.get() + ranges.size(), [](const batch& b) { return b.lined_up; })) {
+            return parser(std::move(tokens), std::move(lines), nodes).parse_program();
+        }
+        std::vector<ast::base_node_ptr> elements;
+        elements.reserve(ends.size());
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            nodes.absorb(batches[i].nodes);
+            elements.insert(elements.end(), batches[i].declarations.begin(), batches[i].declarations.end());
+        }
+        return nodes.make<ast::program_node>(nodes.copy(ast::node_list(elements)));
+    }
+
+    std::vector<size_t> parser::declaration_ends(const std::span<const lexer::token> tokens) {
+        std::vector<size_t> ends;
+        int depth = 0;
+        for (size_t i = 0; i < tokens.size(); ++i) {
+            switch (tokens[i].type) {
+                case lexer::token::TOKEN_TYPE::LeftBrace:
+                    ++depth;
+                    break;
+                case lexer::token::TOKEN_TYPE::RightBrace:
+                    if (--depth < 0) {
+                        return {};
+                    }
+                    break;
+                case lexer::token::TOKEN_TYPE::Semicolon:
+                    if (depth == 0) {
+                        ends.push_back(i + 1);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+        return depth == 0 ? ends : std::vector<size_t>{};
+    }
+
+    ast::base_node_ptr parser::parse_declaration() {
+        if (is_at_end()) {
+            return nullptr;
+        }
+        return parse_top_level_decl();
+    }
+
+    size_t parser::consumed() const noexcept {
+        return m_current;
+    }
+
+    void parser::restart() {
+        m_current = 0;
+        m_pulled = 0;
+        m_nesting = 0;
+        m_scratch.clear();
+    }
+
+    ast::node_list parser::take_list(const size_t mark) {
+        const ast::node_list list = m_nodes.copy(ast::node_list(m_scratch).subspan(mark));
+        m_scratch.resize(mark);
+        return list;
     }
 
     // Distinguish between:
@@ -92,18 +276,18 @@ namespace ent {
     // format: fn name(params) -> type; or fn name(params) -> type { ... }
     ast::base_node_ptr parser::parse_function(bool is_extern) {
         consume(lexer::token::TOKEN_TYPE::Identifier, "Expected function name after 'fn'.");
-        const std::string_view name = previous().value;
+        const symbol_id name = previous().symbol;
 
         consume(lexer::token::TOKEN_TYPE::LeftParen, "Expected '(' after function name.");
-        std::vector<ast::base_node_ptr> parameters;
+        const size_t parameters = m_scratch.size();
 
         // parameters: (type name, type name, ...)
         if (!check(lexer::token::TOKEN_TYPE::RightParen)) {
             do {
                 auto ptype = parse_type();
                 consume(lexer::token::TOKEN_TYPE::Identifier, "Expected parameter name.");
-                std::string_view pname = previous().value;
-                parameters.push_back(std::make_shared<ast::parameter_node>(pname, ptype));
+                const symbol_id pname = previous().symbol;
+                m_scratch.push_back(m_nodes.make<ast::parameter_node>(pname, ptype));
             } while (match(lexer::token::TOKEN_TYPE::Comma));
         }
 
@@ -115,29 +299,43 @@ namespace ent {
         // Now check if it's a definition or just a declaration
         if (match(lexer::token::TOKEN_TYPE::Semicolon)) {
             // forward-declared function with mangling
-            return std::make_shared<ast::function_prototype_node>(rtype, name, parameters);
+            return m_nodes.make<ast::function_prototype_node>(rtype, name, take_list(parameters));
         }
         // must be a definition
         consume(lexer::token::TOKEN_TYPE::LeftBrace, "Expected '{' to start function body.");
+        if (m_outline) {
+            // Only where the body ends matters for now, and that is down to the braces alone
+            const size_t begin = consumed();
+            for (int depth = 1; !is_at_end(); advance()) {
+                if (check(lexer::token::TOKEN_TYPE::LeftBrace)) {
+                    ++depth;
+                } else if (check(lexer::token::TOKEN_TYPE::RightBrace) && --depth == 0) {
+                    break;
+                }
+            }
+            consume(lexer::token::TOKEN_TYPE::RightBrace, "Expected '}' after block.");
+            consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after function body");
+            return m_nodes.make<ast::function_node>(rtype, name, take_list(parameters), m_outline->defer(begin));
+        }
         auto body = parse_block();
         consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after function body");
-        return std::make_shared<ast::function_node>(rtype, name, parameters, body);
+        return m_nodes.make<ast::function_node>(rtype, name, take_list(parameters), body);
     }
 
     // parse_function_prototype for extern function:
     // extern fn name(...) -> type; or fn name(..) -> type;
     ast::base_node_ptr parser::parse_function_prototype(bool is_extern) {
         consume(lexer::token::TOKEN_TYPE::Identifier, "Expected function name after 'fn'.");
-        const std::string_view name = previous().value;
+        const symbol_id name = previous().symbol;
 
         consume(lexer::token::TOKEN_TYPE::LeftParen, "Expected '(' after function name.");
-        std::vector<ast::base_node_ptr> parameters;
+        const size_t parameters = m_scratch.size();
         if (!check(lexer::token::TOKEN_TYPE::RightParen)) {
             do {
                 auto ptype = parse_type();
                 consume(lexer::token::TOKEN_TYPE::Identifier, "Expected parameter name.");
-                std::string_view pname = previous().value;
-                parameters.push_back(std::make_shared<ast::parameter_node>(pname, ptype));
+                const symbol_id pname = previous().symbol;
+                m_scratch.push_back(m_nodes.make<ast::parameter_node>(pname, ptype));
             } while (match(lexer::token::TOKEN_TYPE::Comma));
         }
         consume(lexer::token::TOKEN_TYPE::RightParen, "Expected ')' after parameters.");
@@ -145,8 +343,8 @@ namespace ent {
         consume(lexer::token::TOKEN_TYPE::Greater, "Expected '->' after function parameters.");
         auto rtype = parse_type();
         consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after extern function prototype.");
-        return std::make_shared<ast::extern_node>(
-                std::make_shared<ast::function_prototype_node>(rtype, name, parameters)
+        return m_nodes.make<ast::extern_node>(
+                m_nodes.make<ast::function_prototype_node>(rtype, name, take_list(parameters))
         );
     }
 
@@ -158,15 +356,15 @@ namespace ent {
     ast::base_node_ptr parser::parse_global_variable(const bool is_extern) {
         auto vtype = parse_type();
         consume(lexer::token::TOKEN_TYPE::Identifier, "Expected variable name.");
-        std::string_view name = previous().value;
+        const symbol_id name = previous().symbol;
 
         ast::base_node_ptr init = nullptr;
         if (is_extern) {
             // extern type name; no initialization allowed
             consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after extern variable.");
-            auto var_decl = std::make_shared<ast::variable_declaration_node>(name, vtype);
+            auto var_decl = m_nodes.make<ast::variable_declaration_node>(name, vtype);
             // wrap in extern_node
-            return std::make_shared<ast::extern_node>(var_decl);
+            return m_nodes.make<ast::extern_node>(var_decl);
         }
         // type name [= expr];
 
@@ -175,26 +373,23 @@ namespace ent {
         }
         consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after global variable declaration.");
         if (init) {
-            return std::make_shared<ast::variable_declaration_assign_node>(name, vtype, init);
+            return m_nodes.make<ast::variable_declaration_assign_node>(name, vtype, init);
         }
-        return std::make_shared<ast::variable_declaration_node>(name, vtype);
+        return m_nodes.make<ast::variable_declaration_node>(name, vtype);
     }
 
-    variable_type parser::parse_type() {
+    type_id parser::parse_type() {
         if (!is_type_keyword(current())) {
             error(current(), "Expected type keyword.");
         }
-        const std::string_view base = current().value;
+        // The type keywords are declared in primitive_type order
+        type_id type = type_table::primitive(static_cast<primitive_type>(
+                static_cast<int>(current().type) - static_cast<int>(lexer::token::TOKEN_TYPE::Void)));
         advance();
-        int ptr_count = 0;
         while (match(lexer::token::TOKEN_TYPE::Star)) {
-            ptr_count++;
+            type = type_table::pointer_to(type);
         }
-        variable_type vtype;
-        vtype.base_type = base;
-        vtype.pointer = ptr_count;
-        vtype.is_struct = false; // for now (struct are going to be ouchy)
-        return vtype;
+        return type;
     }
 
     bool parser::is_type_keyword(const lexer::token& tok) {
@@ -233,12 +428,12 @@ namespace ent {
     }
 
     ast::base_node_ptr parser::parse_block() {
-        std::vector<ast::base_node_ptr> statements;
+        const size_t statements = m_scratch.size();
         while (!check(lexer::token::TOKEN_TYPE::RightBrace) && !is_at_end()) {
-            statements.push_back(parse_statement());
+            m_scratch.push_back(parse_statement());
         }
         consume(lexer::token::TOKEN_TYPE::RightBrace, "Expected '}' after block.");
-        return std::make_shared<ast::body_node>(std::move(statements));
+        return m_nodes.make<ast::body_node>(take_list(statements));
     }
 
     ast::base_node_ptr parser::parse_if_statement() {
@@ -260,14 +455,14 @@ namespace ent {
             consume(lexer::token::TOKEN_TYPE::LeftBrace, "Expected '{' after else if condition.");
             auto else_if_body = parse_block();
 
-            auto else_if_node = std::make_shared<ast::if_node>(else_if_condition, else_if_body, nullptr);
+            auto else_if_node = m_nodes.make<ast::if_node>(else_if_condition, else_if_body, nullptr);
 
             if (!false_body) {
                 false_body = else_if_node;
             } else {
-                auto current = std::dynamic_pointer_cast<ast::if_node>(false_body);
+                auto current = ast::node_cast<ast::if_node>(false_body);
                 while (current->false_body() && current->false_body()->type() == ast::NODE_TYPE::If) {
-                    current = std::dynamic_pointer_cast<ast::if_node>(current->false_body());
+                    current = ast::node_cast<ast::if_node>(current->false_body());
                 }
                 current->set_false_body(else_if_node);
             }
@@ -280,15 +475,15 @@ namespace ent {
             if (!false_body) {
                 false_body = else_body;
             } else {
-                auto current = std::dynamic_pointer_cast<ast::if_node>(false_body);
+                auto current = ast::node_cast<ast::if_node>(false_body);
                 while (current->false_body() && current->false_body()->type() == ast::NODE_TYPE::If) {
-                    current = std::dynamic_pointer_cast<ast::if_node>(current->false_body());
+                    current = ast::node_cast<ast::if_node>(current->false_body());
                 }
                 current->set_false_body(else_body);
             }
         }
 
-        return std::make_shared<ast::if_node>(condition, true_body, false_body);
+        return m_nodes.make<ast::if_node>(condition, true_body, false_body);
     }
 
 
@@ -298,7 +493,7 @@ namespace ent {
         consume(lexer::token::TOKEN_TYPE::RightParen, "Expected ')' after while condition.");
         consume(lexer::token::TOKEN_TYPE::LeftBrace, "Expected '{' after while condition.");
         auto body = parse_block();
-        return std::make_shared<ast::while_node>(condition, body);
+        return m_nodes.make<ast::while_node>(condition, body);
     }
 
     ast::base_node_ptr parser::parse_switch_statement() {
@@ -307,68 +502,68 @@ namespace ent {
         consume(lexer::token::TOKEN_TYPE::RightParen, "Expected ')' after switch expression.");
         consume(lexer::token::TOKEN_TYPE::LeftBrace, "Expected '{' after switch.");
 
-        std::vector<ast::base_node_ptr> cases;
+        const size_t cases = m_scratch.size();
         ast::base_node_ptr default_case = nullptr;
         while (!check(lexer::token::TOKEN_TYPE::RightBrace) && !is_at_end()) {
             if (match(lexer::token::TOKEN_TYPE::Case)) {
-                cases.push_back(parse_case_statement());
+                m_scratch.push_back(parse_case_statement());
             } else if (match(lexer::token::TOKEN_TYPE::Default)) {
                 consume(lexer::token::TOKEN_TYPE::Colon, "Expected ':' after 'default'.");
-                std::vector<ast::base_node_ptr> stmts;
+                const size_t stmts = m_scratch.size();
                 while (!check(lexer::token::TOKEN_TYPE::Case) &&
                        !check(lexer::token::TOKEN_TYPE::Default) &&
                        !check(lexer::token::TOKEN_TYPE::RightBrace) &&
                        !is_at_end()) {
-                    stmts.push_back(parse_statement());
+                    m_scratch.push_back(parse_statement());
                 }
-                default_case = std::make_shared<ast::body_node>(std::move(stmts));
+                default_case = m_nodes.make<ast::body_node>(take_list(stmts));
             } else {
                 error(current(), "Expected 'case' or 'default' in switch.");
             }
         }
 
         consume(lexer::token::TOKEN_TYPE::RightBrace, "Expected '}' after switch.");
-        return std::make_shared<ast::switch_node>(expr, cases, default_case);
+        return m_nodes.make<ast::switch_node>(expr, take_list(cases), default_case);
     }
 
     ast::base_node_ptr parser::parse_case_statement() {
         auto val_expr = parse_expression();
         consume(lexer::token::TOKEN_TYPE::Colon, "Expected ':' after case value.");
-        std::vector<ast::base_node_ptr> stmts;
+        const size_t stmts = m_scratch.size();
         while (!check(lexer::token::TOKEN_TYPE::Case) &&
                !check(lexer::token::TOKEN_TYPE::Default) &&
                !check(lexer::token::TOKEN_TYPE::RightBrace) &&
                !is_at_end()) {
-            stmts.push_back(parse_statement());
+            m_scratch.push_back(parse_statement());
         }
-        return std::make_shared<ast::case_node>(val_expr, std::make_shared<ast::body_node>(std::move(stmts)));
+        return m_nodes.make<ast::case_node>(val_expr, m_nodes.make<ast::body_node>(take_list(stmts)));
     }
 
     ast::base_node_ptr parser::parse_return_statement() {
         if (!check(lexer::token::TOKEN_TYPE::Semicolon)) {
             auto val = parse_expression();
             consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after return value.");
-            return std::make_shared<ast::return_node>(val);
+            return m_nodes.make<ast::return_node>(val);
         }
         advance();
-        return std::make_shared<ast::return_node>(nullptr);
+        return m_nodes.make<ast::return_node>(nullptr);
     }
 
     ast::base_node_ptr parser::parse_break_statement() {
         consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after 'break'.");
-        return std::make_shared<ast::break_node>();
+        return m_nodes.make<ast::break_node>();
     }
 
     ast::base_node_ptr parser::parse_continue_statement() {
         consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after 'continue'.");
-        return std::make_shared<ast::continue_node>();
+        return m_nodes.make<ast::continue_node>();
     }
 
     // type name [= expr];
     ast::base_node_ptr parser::parse_variable_declaration(bool allow_extern) {
         const auto vtype = parse_type();
         consume(lexer::token::TOKEN_TYPE::Identifier, "Expected variable name after type.");
-        std::string_view name = previous().value;
+        const symbol_id name = previous().symbol;
 
         ast::base_node_ptr init = nullptr;
         if (match(lexer::token::TOKEN_TYPE::Assign)) {
@@ -376,9 +571,9 @@ namespace ent {
         }
         consume(lexer::token::TOKEN_TYPE::Semicolon, "Expected ';' after variable declaration.");
         if (init) {
-            return std::make_shared<ast::variable_declaration_assign_node>(name, vtype, init);
+            return m_nodes.make<ast::variable_declaration_assign_node>(name, vtype, init);
         }
-        return std::make_shared<ast::variable_declaration_node>(name, vtype);
+        return m_nodes.make<ast::variable_declaration_node>(name, vtype);
     }
 
     // === Expressions ===
@@ -387,136 +582,66 @@ namespace ent {
     }
 
     ast::base_node_ptr parser::parse_assignment_expr() {
-        auto lhs = parse_logical_or_expr();
+        auto lhs = parse_binary_expr(0);
 
         if (match(lexer::token::TOKEN_TYPE::Assign)) {
+            // Chained assignments nest to the right, one level each
+            const nesting_guard guard(*this);
             auto rhs = parse_assignment_expr();
 
-            const auto var = std::dynamic_pointer_cast<ast::variable_node>(lhs);
+            const auto var = ast::node_cast<ast::variable_node>(lhs);
             if (!var) {
                 error(current(), "Left-hand side of assignment must be assignable.");
             }
 
-            return std::make_shared<ast::assignment_node>(var->get_name(), rhs);
+            return m_nodes.make<ast::assignment_node>(var->m_name, rhs);
         }
 
         return lhs;
     }
 
-    ast::base_node_ptr parser::parse_logical_or_expr() {
-        auto node = parse_logical_and_expr();
-        while (match(lexer::token::TOKEN_TYPE::Pipe) && match(lexer::token::TOKEN_TYPE::Pipe)) {
-            auto right = parse_logical_and_expr();
-            node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::LOGICAL_OR, right);
-        }
-        return node;
-    }
-
-    ast::base_node_ptr parser::parse_logical_and_expr() {
-        auto node = parse_equality_expr();
-        while (match(lexer::token::TOKEN_TYPE::Ampersand) && match(lexer::token::TOKEN_TYPE::Ampersand)) {
-            auto right = parse_equality_expr();
-            node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::LOGICAL_AND, right);
-        }
-        return node;
-    }
-
-    ast::base_node_ptr parser::parse_equality_expr() {
-        auto node = parse_relational_expr();
-        while (true) {
-            if (match(lexer::token::TOKEN_TYPE::Equal)) {
-                auto right = parse_relational_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::EQUAL, right);
-            } else if (match(lexer::token::TOKEN_TYPE::NotEqual)) {
-                auto right = parse_relational_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::NOT_EQUAL, right);
-            } else {
-                break;
-            }
-        }
-        return node;
-    }
-
-    ast::base_node_ptr parser::parse_relational_expr() {
-        auto node = parse_additive_expr();
-        while (true) {
-            if (match(lexer::token::TOKEN_TYPE::Less)) {
-                auto right = parse_additive_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::LESS, right);
-            } else if (match(lexer::token::TOKEN_TYPE::LessEqual)) {
-                auto right = parse_additive_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::LESS_EQUAL, right);
-            } else if (match(lexer::token::TOKEN_TYPE::Greater)) {
-                auto right = parse_additive_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::GREATER, right);
-            } else if (match(lexer::token::TOKEN_TYPE::GreaterEqual)) {
-                auto right = parse_additive_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::GREATER_EQUAL, right);
-            } else {
-                break;
-            }
-        }
-        return node;
-    }
-
-    ast::base_node_ptr parser::parse_additive_expr() {
-        auto node = parse_multiplicative_expr();
-        while (true) {
-            if (match(lexer::token::TOKEN_TYPE::Plus)) {
-                auto right = parse_multiplicative_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::ADDITION, right);
-            } else if (match(lexer::token::TOKEN_TYPE::Minus)) {
-                auto right = parse_multiplicative_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::SUBTRACTION, right);
-            } else {
-                break;
-            }
-        }
-        return node;
-    }
-
-    ast::base_node_ptr parser::parse_multiplicative_expr() {
+    // Precedence climbing: operators that bind tighter than `min_precedence` are folded into the left
+    // operand in a loop, so a chain of operators costs one call per precedence step instead of one per level
+    ast::base_node_ptr parser::parse_binary_expr(const int min_precedence) {
         auto node = parse_unary_expr();
         while (true) {
-            if (match(lexer::token::TOKEN_TYPE::Star)) {
-                auto right = parse_unary_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::MULTIPLICATION, right);
-            } else if (match(lexer::token::TOKEN_TYPE::Slash)) {
-                auto right = parse_unary_expr();
-                node = std::make_shared<ast::expression_node>(node, ast::EXPRESSION_NODE_OP::DIVISION, right);
-            } else {
+            const operator_info& info = operator_table[static_cast<size_t>(current().type)];
+            if (info.precedence <= min_precedence) {
                 break;
             }
+            advance();
+            // All binary operators are left associative, the right operand only takes tighter ones
+            auto right = parse_binary_expr(info.precedence);
+            node = m_nodes.make<ast::expression_node>(node, info.op, right);
         }
         return node;
     }
 
     ast::base_node_ptr parser::parse_unary_expr() {
+        // Every way an expression can nest, parentheses, arguments, indices and prefix operators, comes back through here
+        const nesting_guard guard(*this);
         if (match(lexer::token::TOKEN_TYPE::Increment)) {
             const auto operand = parse_unary_expr();
-            const auto var = std::dynamic_pointer_cast<ast::variable_node>(operand);
+            const auto var = ast::node_cast<ast::variable_node>(operand);
             if (!var) {
                 error(current(), "Prefix ++ operator applied to a non-variable expression.");
             }
-            return std::make_shared<ast::increment_node>(var->get_name(), true);
+            return m_nodes.make<ast::increment_node>(var->m_name, true);
         }
         if (match(lexer::token::TOKEN_TYPE::Decrement)) {
             const auto operand = parse_unary_expr();
-            const auto var = std::dynamic_pointer_cast<ast::variable_node>(operand);
+            const auto var = ast::node_cast<ast::variable_node>(operand);
             if (!var) {
                 error(current(), "Prefix -- operator applied to a non-variable expression.");
             }
-            return std::make_shared<ast::decrement_node>(var->get_name(), true);
+            return m_nodes.make<ast::decrement_node>(var->m_name, true);
         }
 
-        if (match(lexer::token::TOKEN_TYPE::Minus) ||
-            match(lexer::token::TOKEN_TYPE::Plus) ||
-            match(lexer::token::TOKEN_TYPE::Exclamation) ||
-            match(lexer::token::TOKEN_TYPE::Ampersand) ||
-            match(lexer::token::TOKEN_TYPE::Star)) {
-            auto op = previous().type;
+        if (operator_table[static_cast<size_t>(current().type)].prefix) {
+            const auto op = current().type;
+            advance();
             auto operand = parse_unary_expr();
-            return std::make_shared<ast::unary_node>(op, operand);
+            return m_nodes.make<ast::unary_node>(op, operand);
         }
         return parse_primary_expr();
     }
@@ -530,25 +655,25 @@ namespace ent {
         }
 
         if (match(lexer::token::TOKEN_TYPE::Decimal)) {
-            auto node = dynamic_pointer_cast<ast::base_node>(std::make_shared<ast::literal_node>(previous().value, ast::literal_node::LITERAL_TYPE::Decimal));
+            ast::base_node_ptr node = m_nodes.make<ast::literal_node>(previous().symbol, ast::literal_node::LITERAL_TYPE::Decimal);
             node = parse_postfix_operators(node);
             return node;
         }
 
         if (match(lexer::token::TOKEN_TYPE::Hexadecimal)) {
-            auto node = dynamic_pointer_cast<ast::base_node>(std::make_shared<ast::literal_node>(previous().value, ast::literal_node::LITERAL_TYPE::Hexadecimal));
+            ast::base_node_ptr node = m_nodes.make<ast::literal_node>(previous().symbol, ast::literal_node::LITERAL_TYPE::Hexadecimal);
             node = parse_postfix_operators(node);
             return node;
         }
 
         if (match(lexer::token::TOKEN_TYPE::Binary)) {
-            auto node = dynamic_pointer_cast<ast::base_node>(std::make_shared<ast::literal_node>(previous().value, ast::literal_node::LITERAL_TYPE::Binary));
+            ast::base_node_ptr node = m_nodes.make<ast::literal_node>(previous().symbol, ast::literal_node::LITERAL_TYPE::Binary);
             node = parse_postfix_operators(node);
             return node;
         }
 
         if (match(lexer::token::TOKEN_TYPE::StringLiteral)) {
-            auto node = dynamic_pointer_cast<ast::base_node>(std::make_shared<ast::string_literal_node>(previous().value));
+            ast::base_node_ptr node = m_nodes.make<ast::string_literal_node>(previous().symbol);
             node = parse_postfix_operators(node);
             return node;
         }
@@ -564,20 +689,20 @@ namespace ent {
     }
 
     ast::base_node_ptr parser::parse_function_call_or_variable() {
-        auto name = previous().value;
+        const symbol_id name = previous().symbol;
 
         ast::base_node_ptr node;
         if (match(lexer::token::TOKEN_TYPE::LeftParen)) {
-            std::vector<ast::base_node_ptr> args;
+            const size_t args = m_scratch.size();
             if (!check(lexer::token::TOKEN_TYPE::RightParen)) {
                 do {
-                    args.push_back(parse_expression());
+                    m_scratch.push_back(parse_expression());
                 } while (match(lexer::token::TOKEN_TYPE::Comma));
             }
             consume(lexer::token::TOKEN_TYPE::RightParen, "Expected ')' after arguments.");
-            node = std::make_shared<ast::function_call_node>(name, std::move(args));
+            node = m_nodes.make<ast::function_call_node>(name, take_list(args));
         } else {
-            node = std::make_shared<ast::variable_node>(name);
+            node = m_nodes.make<ast::variable_node>(name);
         }
 
         while (true) {
@@ -585,29 +710,29 @@ namespace ent {
                 // Indexing: var[idx]
                 auto idx = parse_expression();
                 consume(lexer::token::TOKEN_TYPE::RightBracket, "Expected ']' after index.");
-                node = std::make_shared<ast::index_access_node>(std::dynamic_pointer_cast<ast::variable_node>(node)->get_name(), idx);
+                node = m_nodes.make<ast::index_access_node>(ast::node_cast<ast::variable_node>(node)->m_name, idx);
             } else if (match(lexer::token::TOKEN_TYPE::Period)) {
                 // Member access: node.member or node.member(...)
                 consume(lexer::token::TOKEN_TYPE::Identifier, "Expected member name after '.'.");
-                std::string_view member = previous().value;
+                const symbol_id member = previous().symbol;
 
                 // UFCS? (and todo struct's function pointers)
                 if (check(lexer::token::TOKEN_TYPE::LeftParen)) {
                     advance();
-                    std::vector<ast::base_node_ptr> args;
+                    const size_t args = m_scratch.size();
 
-                    args.push_back(node);
+                    m_scratch.push_back(node);
 
                     if (!check(lexer::token::TOKEN_TYPE::RightParen)) {
                         do {
-                            args.push_back(parse_expression());
+                            m_scratch.push_back(parse_expression());
                         } while (match(lexer::token::TOKEN_TYPE::Comma));
                     }
                     consume(lexer::token::TOKEN_TYPE::RightParen, "Expected ')' after arguments.");
 
-                    node = std::make_shared<ast::function_call_node>(member, std::move(args));
+                    node = m_nodes.make<ast::function_call_node>(member, take_list(args));
                 } else {
-                    node = std::make_shared<ast::member_invoke_node>(node, member);
+                    node = m_nodes.make<ast::member_invoke_node>(node, member);
                 }
             } else {
                 break;
@@ -619,39 +744,15 @@ namespace ent {
 
 
     ast::EXPRESSION_NODE_OP parser::token_to_expression_op(const lexer::token::TOKEN_TYPE type) {
-        switch (type) {
-            case lexer::token::TOKEN_TYPE::Plus: return ast::EXPRESSION_NODE_OP::ADDITION;
-            case lexer::token::TOKEN_TYPE::Minus: return ast::EXPRESSION_NODE_OP::SUBTRACTION;
-            case lexer::token::TOKEN_TYPE::Star: return ast::EXPRESSION_NODE_OP::MULTIPLICATION;
-            case lexer::token::TOKEN_TYPE::Slash: return ast::EXPRESSION_NODE_OP::DIVISION;
-            default: return ast::EXPRESSION_NODE_OP::ADDITION; // fallback
-        }
+        return operator_table[static_cast<size_t>(type)].op;
     }
 
     bool parser::is_unary_operator(const lexer::token& tok) {
-        return tok.type == lexer::token::TOKEN_TYPE::Plus ||
-               tok.type == lexer::token::TOKEN_TYPE::Minus ||
-                tok.type == lexer::token::TOKEN_TYPE::Exclamation ||
-               tok.type == lexer::token::TOKEN_TYPE::Ampersand ||
-               tok.type == lexer::token::TOKEN_TYPE::Star;
+        return operator_table[static_cast<size_t>(tok.type)].prefix;
     }
 
     bool parser::is_binary_operator(const lexer::token& tok) {
-        switch (tok.type) {
-            case lexer::token::TOKEN_TYPE::Plus:
-            case lexer::token::TOKEN_TYPE::Minus:
-            case lexer::token::TOKEN_TYPE::Star:
-            case lexer::token::TOKEN_TYPE::Slash:
-            case lexer::token::TOKEN_TYPE::Equal:
-            case lexer::token::TOKEN_TYPE::NotEqual:
-            case lexer::token::TOKEN_TYPE::Less:
-            case lexer::token::TOKEN_TYPE::LessEqual:
-            case lexer::token::TOKEN_TYPE::Greater:
-            case lexer::token::TOKEN_TYPE::GreaterEqual:
-                return true;
-            default:
-                return false;
-        }
+        return operator_table[static_cast<size_t>(tok.type)].precedence > 0;
     }
 
     ast::base_node_ptr parser::parse_postfix_operators(ast::base_node_ptr expr) {
@@ -663,18 +764,18 @@ namespace ent {
         while (true) {
             if (match(lexer::token::TOKEN_TYPE::Increment)) {
                 // Postfix ++
-                const auto var = std::dynamic_pointer_cast<ast::variable_node>(expr);
+                const auto var = ast::node_cast<ast::variable_node>(expr);
                 if (!var) {
                     error(current(), "Postfix ++ operator applied to non-variable expression.");
                 }
-                expr = std::make_shared<ast::increment_node>(var->get_name(), false);
+                expr = m_nodes.make<ast::increment_node>(var->m_name, false);
             } else if (match(lexer::token::TOKEN_TYPE::Decrement)) {
                 // Postfix --
-                const auto var = std::dynamic_pointer_cast<ast::variable_node>(expr);
+                const auto var = ast::node_cast<ast::variable_node>(expr);
                 if (!var) {
                     error(current(), "Postfix -- operator applied to non-variable expression.");
                 }
-                expr = std::make_shared<ast::decrement_node>(var->get_name(), false);
+                expr = m_nodes.make<ast::decrement_node>(var->m_name, false);
             } else {
                 break;
             }
@@ -682,4 +783,27 @@ namespace ent {
         return expr;
     }
 
+    outline::outline(std::vector<lexer::token> tokens, line_index lines, arena& nodes)
+        : m_tokens(std::move(tokens)),
+          m_parser([this] { return m_tokens[std::min(m_next++, m_tokens.size() - 1)]; }, std::move(lines), nodes) {
+        m_parser.m_outline = this;
+        m_program = m_parser.parse_program();
+        m_parser.m_outline = nullptr;
+    }
+
+    ast::base_node_ptr outline::program() const noexcept {
+        return m_program;
+    }
+
+    const ast::deferred_body* outline::defer(const size_t begin) {
+        return m_parser.m_nodes.make<ast::deferred_body>(&outline::parse_body, this, begin);
+    }
+
+    ast::base_node_ptr outline::parse_body(void* owner, const size_t begin) {
+        auto& self = *static_cast<outline*>(owner);
+        self.m_next = begin;
+        self.m_parser.restart();
+        return self.m_parser.parse_block();
+    }
+
 } // namespace ent
@@ -4,10 +4,12 @@
 #include "Lexer.hh"
 #include "AST.icc"
 #include "Error.hh"
+#include "ThreadPool.hh"
 #include <stdexcept>
 #include <string_view>
 #include <string>
 #include <optional>
+#include <span>
 #include <format>
 
 namespace ent {
@@ -18,14 +20,32 @@ namespace ent {
             : error(std::format("{} at line {}, column {}", msg, line, col)) {}
     };
 
+    class outline;
+
     class parser {
     public:
-        explicit parser(std::vector<lexer::token> tokens)
-            : m_tokens(std::move(tokens)) {}
+        // Nodes are made in `nodes`, which has to outlive every tree the parser returns
+        parser(std::vector<lexer::token> tokens, line_index lines, arena& nodes)
+            : parser(vector_source(std::move(tokens)), std::move(lines), nodes) {}
+        // Pulls tokens as it goes, holding no more than the lookahead window
+        parser(token_source tokens, line_index lines, arena& nodes)
+            : m_source(std::move(tokens)), m_lines(std::move(lines)), m_nodes(nodes) {}
 
         ast::base_node_ptr parse_program();
+        // Same tree as parse_program(), but the top-level declarations are split at every `;` outside
+        // braces and parsed in batches on `pool`. Falls back to parsing in sequence whenever the split
+        // does not line up with what the parser sees, so errors are reported exactly as parse_program()
+        // would report them.
+        static ast::base_node_ptr parse_program_parallel(std::vector<lexer::token> tokens, line_index lines,
+                                                         arena& nodes, thread_pool& pool);
+        // One top-level declaration at a time, nullptr once the input is exhausted
+        ast::base_node_ptr parse_declaration();
+        // Number of tokens consumed so far
+        [[nodiscard]] size_t consumed() const noexcept;
 
     private:
+        friend class outline;
+
         [[nodiscard]] const lexer::token& peek(size_t offset = 0) const;
         [[nodiscard]] const lexer::token& current() const;
         [[nodiscard]] const lexer::token& previous() const;
@@ -33,14 +53,20 @@ namespace ent {
         [[nodiscard]] bool check(lexer::token::TOKEN_TYPE type) const;
         void advance();
         void consume(lexer::token::TOKEN_TYPE type, std::string_view message);
-        [[noreturn]] static void error(const lexer::token& tok, std::string_view message);
+        [[noreturn]] void error(const lexer::token& tok, std::string_view message) const;
         [[nodiscard]] bool is_at_end() const;
+        // Token index just past every `;` outside braces, empty if the braces do not balance
+        static std::vector<size_t> declaration_ends(std::span<const lexer::token> tokens);
+        // Forgets every token seen, the next one is pulled from the source afresh
+        void restart();
+        // Moves the children pushed onto m_scratch since `mark` into the arena
+        ast::node_list take_list(size_t mark);
 
         ast::base_node_ptr parse_top_level_decl();
         ast::base_node_ptr parse_function(bool is_extern = false);
         ast::base_node_ptr parse_function_prototype(bool is_extern = false);
         ast::base_node_ptr parse_global_variable(bool is_extern);
-        variable_type parse_type();
+        type_id parse_type();
 
         static bool is_type_keyword(const lexer::token& tok);
 
@@ -60,12 +86,8 @@ namespace ent {
 
         // Expressions
         ast::base_node_ptr parse_expression();
-        ast::base_node_ptr parse_logical_or_expr();
-        ast::base_node_ptr parse_logical_and_expr();
-        ast::base_node_ptr parse_equality_expr();
-        ast::base_node_ptr parse_relational_expr();
-        ast::base_node_ptr parse_additive_expr();
-        ast::base_node_ptr parse_multiplicative_expr();
+        // Binary operators binding tighter than `min_precedence`, driven by the operator table in Parser.cc
+        ast::base_node_ptr parse_binary_expr(int min_precedence);
         ast::base_node_ptr parse_unary_expr();
         ast::base_node_ptr parse_primary_expr();
         ast::base_node_ptr parse_function_call_or_variable();
@@ -77,8 +99,65 @@ namespace ent {
         static bool is_binary_operator(const lexer::token& tok);
         ast::base_node_ptr parse_postfix_operators(ast::base_node_ptr expr);
 
-        std::vector<lexer::token> m_tokens;
+        // Below this many tokens parse_program_parallel() does not bother with the pool
+        static constexpr size_t min_parallel_tokens = 16 * 1024;
+        static constexpr size_t min_batch_tokens = 4 * 1024;
+
+        // Deeper expressions are rejected rather than allowed to run the stack out
+        static constexpr int max_nesting = 1024;
+
+        // Counts one level of expression nesting while it lives
+        class nesting_guard {
+        public:
+            explicit nesting_guard(parser& owner);
+            ~nesting_guard();
+            nesting_guard(const nesting_guard&) = delete;
+            nesting_guard& operator=(const nesting_guard&) = delete;
+        private:
+            parser& m_owner;
+        };
+
+        // previous(), current() and peek(1) are as far as the grammar ever looks
+        static constexpr size_t window_size = 4;
+
+        token_source m_source;
+        mutable std::vector<lexer::token> m_window = std::vector(window_size, lexer::token(lexer::token::TOKEN_TYPE::EOFToken, 0, 0));
+        // Number of tokens pulled so far, token i lives in m_window[i % window_size]
+        mutable size_t m_pulled = 0;
+        line_index m_lines;
         size_t m_current = 0;
+        int m_nesting = 0;
+        arena& m_nodes;
+        // Children of every list still being parsed, innermost last; lists are copied out once complete
+        std::vector<ast::base_node_ptr> m_scratch;
+        // Set while parsing an outline, function bodies are skipped and left to it
+        outline* m_outline = nullptr;
+    };
+
+    // Signatures and globals of a program, with every function body skipped by brace matching and
+    // only parsed once function_node::body() asks for it. The tokens are kept here for that, so the
+    // outline has to outlive the tree. Bodies are parsed on the thread that asks, one at a time.
+    class outline {
+    public:
+        outline(std::vector<lexer::token> tokens, line_index lines, arena& nodes);
+
+        outline(const outline&) = delete;
+        outline& operator=(const outline&) = delete;
+
+        [[nodiscard]] ast::base_node_ptr program() const noexcept;
+
+    private:
+        friend class parser;
+
+        // Records the body starting at token `begin` for later
+        const ast::deferred_body* defer(size_t begin);
+        static ast::base_node_ptr parse_body(void* owner, size_t begin);
+
+        std::vector<lexer::token> m_tokens;
+        // Next token m_parser pulls
+        size_t m_next = 0;
+        parser m_parser;
+        ast::base_node_ptr m_program;
     };
 
 } // namespace ent
@@ -3,171 +3,473 @@
 //
 #include "Preprocessor.hh"
 #include <string_view>
-#include <fstream>
-#include <regex>
+#include <algorithm>
+#include <filesystem>
+#include <ranges>
 #include <format>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace ent {
-    preprocessor::preprocessor(const std::string_view filename) : m_filename(filename), m_file(filename.data()) {
-        if (!m_file.is_open()) {
+    mapped_file::mapped_file(const std::string_view filename) {
+        const int fd = ::open(std::string(filename).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
             throw file_not_found_error(filename);
         }
 
-        static const std::regex header_start_regex(R"(^\s*header\s*\{)");
-        static const std::regex define_regex(R"(^\s*define\s+\w+.*$)");
-        static const std::regex include_regex(R"(^\s*include\s*["<](.*)[">]\s*)");
-
-        while (std::getline(m_file, m_line)) {
-            // If we detect the start of a header block on this line
-            if (std::regex_search(m_line, header_start_regex)) {
-                // We have something like:
-                //   header {
-                // or header { something }
-                // or header { ... multiple braces ... }
-                //
-                // First, find where the header block starts:
-                const std::size_t start_pos = m_line.find('{');
-                if (start_pos == std::string::npos) {
-                    // Should not happen since regex matched, but just in case
-                    throw preprocessor_error(std::format("Malformed header line detected: {}\n", m_line));
-                }
+        struct stat st {};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw preprocessor_error(std::format("Failed to stat file: {}", filename));
+        }
 
-                m_in_header_block = true;
-                m_header_content.clear();
-                m_brace_balance = 0;
-
-                const int line_braces = count_braces(m_line);
-
-                m_brace_balance += line_braces;
-
-                // Extract the portion after "header {", because that's the start of the block content
-                // We'll append the entire line (minus the 'header ' part) to header content and handle braces
-                // But we must carefully handle where we start adding from:
-                // We'll capture everything from the first '{' since that's where block content truly starts.
-                std::string header_line_content = m_line.substr(start_pos + 1); // content after '{'
-
-                // If after counting line_braces we have m_brace_balance == 0, that means
-                // the block opened and closed on the same line.
-                if (m_brace_balance == 0) {
-                    // This means something like: header { something }
-                    // We should isolate the content inside braces (which we already have as header_line_content).
-                    // The closing brace should be somewhere in header_line_content. Let's remove it:
-                    if (const std::size_t closing_brace = header_line_content.find('}'); closing_brace != std::string::npos) {
-                        std::string content = header_line_content.substr(0, closing_brace);
-                        // TODO Trim whitespace ?
-                        m_header_content += content + '\n';
-                        m_preprocessed_file += content + '\n';
-                    }
-                    // Block ended on the same line
-                    m_in_header_block = false;
-                } else {
-                    // The block continues. The line may have started the block but not ended it.
-                    // We'll include whatever content is after the '{' in the header block.
-                    // There's a possibility that the line had multiple braces,
-                    // so let's carefully handle it. Since we know we didn't close the block yet,
-                    // we keep the line as part of the header and preprocessed file.
-                    m_preprocessed_file += header_line_content + '\n';
-                    m_header_content += header_line_content + '\n';
-                }
-                continue; // Next line
-            }
-
-            if (m_in_header_block) {
-                // Check for includes inside header block
-                // If found, process them recursively
-                if (std::regex_search(m_line, include_regex)) {
-                    std::smatch match;
-                    if (!std::regex_search(m_line, match, include_regex)) {
-                        throw preprocessor_error(std::format("Failed to parse detected include statement in header at:\n{}\n", m_line));
-                    }
-                    std::string include_path = match[1];
-                    if (m_includes.emplace(include_path).second) {
-                        preprocessor prep(include_path);
-                        const std::string included_content = prep.get_header();
-                        m_header_content += included_content;
-                        m_preprocessed_file += included_content;
-                    } else {
-                        throw preprocessor_error(std::format("Cyclic include detected for path: {}\n", include_path));
-                    }
-                } else {
-                    const int line_braces = count_braces(m_line);
-                    m_brace_balance += line_braces;
-
-                    if (m_brace_balance <= 0) {
-                        // This means we've closed the block on this line.
-                        // We need to handle possibly multiple '}' in the line.
-                        // Let's carefully find the brace that closed the block.
-
-                        // We'll find the closing '}' that balances the block.
-                        // Since line_braces can be negative if there are more closing braces than opens,
-                        // we incrementally adjust until balance is back to zero.
-                        int local_balance = line_braces;
-                        std::size_t search_pos = 0;
-                        std::string processed_line;
-                        while (local_balance < 0 && search_pos < m_line.size()) {
-                            const std::size_t brace_pos = m_line.find('}', search_pos);
-                            if (brace_pos == std::string::npos)
-                                break; // no more '}' found
-                            // Each '}' increments by -1
-                            local_balance++;
-                            // We'll take the substring up to the brace that ended the block
-                            if (local_balance == 0) {
-                                // This is the brace that closed the header block
-                                processed_line = m_line.substr(0, brace_pos);
-                                break;
-                            }
-                            search_pos = brace_pos + 1;
-                        }
-
-                        // Add whatever content we got before closing
-                        if (!processed_line.empty()) {
-                            m_preprocessed_file += processed_line + '\n';
-                            m_header_content += processed_line + '\n';
-                        }
-
-                        // Now the block is closed
-                        m_in_header_block = false;
-                    } else {
-                        // Block still open
-                        m_preprocessed_file += m_line + '\n';
-                        m_header_content += m_line + '\n';
-                    }
-                }
-                continue;
+        m_size = static_cast<std::size_t>(st.st_size);
+        if (m_size != 0) {
+            void* data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                ::close(fd);
+                throw preprocessor_error(std::format("Failed to map file: {}", filename));
             }
+            // We only ever walk the buffer front to back
+            ::madvise(data, m_size, MADV_SEQUENTIAL);
+            m_data = static_cast<const char*>(data);
+        }
+        ::close(fd);
+    }
 
-            if (std::regex_search(m_line, define_regex)) {
-                // TODO add macros at Iteration 2 of coding
-            } else if (std::regex_search(m_line, include_regex)) {
-                std::smatch match;
-                if (!std::regex_search(m_line, match, include_regex)) {
-                    throw preprocessor_error(std::format("Failed to parse detected include statement at:\n{}\n", m_line));
-                }
-                std::string include_path = match[1];
-                if (m_includes.emplace(include_path).second) {
-                    preprocessor prep(include_path);
-                    m_preprocessed_file += prep.get_header();
-                } else {
-                    throw preprocessor_error(std::format("Include path is invalid or cyclic in:\n{}\n", m_line));
+    mapped_file::~mapped_file() {
+        if (m_data) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+
+    mapped_file::mapped_file(mapped_file&& other) noexcept
+        : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+
+    mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+        if (this != &other) {
+            if (m_data) {
+                ::munmap(const_cast<char*>(m_data), m_size);
+            }
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+        return *this;
+    }
+
+    std::string_view mapped_file::view() const noexcept {
+        return {m_data, m_size};
+    }
+
+    std::string interface_table::canonicalize(const std::string_view filename) {
+        std::error_code ec;
+        auto canonical = std::filesystem::canonical(std::filesystem::path(filename), ec);
+        if (ec) {
+            throw file_not_found_error(filename);
+        }
+        return canonical.string();
+    }
+
+    // FNV-1a, only used to find byte-identical interfaces reached through different paths
+    std::uint64_t interface_table::hash_content(const std::string_view content) {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (const char c : content) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    interface_table::interface_table(const unsigned workers) : m_pool(workers) {}
+
+    const interface_entry& interface_table::resolve(const interface_entry& entry) {
+        return entry.alias ? *entry.alias : entry;
+    }
+
+    // Called with m_mutex held
+    interface_entry& interface_table::create(std::string canonical) {
+        auto entry = std::make_unique<interface_entry>();
+        entry->path = std::move(canonical);
+        interface_entry& ref = *entry;
+        m_entries.push_back(std::move(entry));
+        m_by_path.emplace(ref.path, &ref);
+        return ref;
+    }
+
+    // Called with m_mutex held
+    interface_entry* interface_table::find_duplicate(const std::uint64_t hash, const std::string_view content) const {
+        auto [it, end] = m_by_hash.equal_range(hash);
+        for (; it != end; ++it) {
+            if (it->second->file.view() == content) {
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    const interface_entry& interface_table::request(const std::string_view filename) {
+        std::string canonical = canonicalize(filename);
+        std::lock_guard lock(m_mutex);
+        if (const auto it = m_by_path.find(canonical); it != m_by_path.end()) {
+            return *it->second;
+        }
+        interface_entry& entry = create(std::move(canonical));
+        m_pool.submit([this, &entry] { scan(entry); });
+        return entry;
+    }
+
+    void interface_table::scan(interface_entry& entry) {
+        entry.file = mapped_file(entry.path);
+        entry.hash = hash_content(entry.file.view());
+        {
+            std::lock_guard lock(m_mutex);
+            if (const interface_entry* duplicate = find_duplicate(entry.hash, entry.file.view())) {
+                entry.alias = duplicate;
+                entry.file = mapped_file();
+                entry.complete = true;
+                return;
+            }
+            m_by_hash.emplace(entry.hash, &entry);
+        }
+        preprocessor header_scan(entry, *this);
+        entry.complete = true;
+    }
+
+    void interface_table::wait() {
+        m_pool.wait();
+    }
+
+    void interface_table::check_cycles(const interface_entry& root) {
+        std::vector<const interface_entry*> stack;
+        check_cycles(root, stack);
+    }
+
+    void interface_table::check_cycles(const interface_entry& entry, std::vector<const interface_entry*>& stack) {
+        const interface_entry& resolved = resolve(entry);
+        if (m_acyclic.contains(&resolved)) {
+            return;
+        }
+        if (const auto it = std::ranges::find(stack, &resolved); it != stack.end()) {
+            std::string chain;
+            for (auto scanning = it; scanning != stack.end(); ++scanning) {
+                chain += (*scanning)->path;
+                chain += " -> ";
+            }
+            chain += resolved.path;
+            throw cyclic_include_error(chain);
+        }
+
+        stack.push_back(&resolved);
+        for (const auto& included : resolved.includes | std::views::values) {
+            check_cycles(*included, stack);
+        }
+        stack.pop_back();
+        m_acyclic.insert(&resolved);
+    }
+
+    const interface_entry& interface_table::load(const std::string_view filename) {
+        const interface_entry& entry = request(filename);
+        wait();
+        check_cycles(entry);
+        return resolve(entry);
+    }
+
+    void interface_table::splice(const interface_entry& entry, source_rope& out, std::unordered_set<const interface_entry*>& spliced) {
+        const interface_entry& resolved = resolve(entry);
+        if (!spliced.insert(&resolved).second) {
+            return;
+        }
+        const auto& spans = resolved.header.spans();
+        std::size_t pos = 0;
+        for (const auto& [index, included] : resolved.includes) {
+            for (; pos < index; ++pos) {
+                out.append(spans[pos]);
+            }
+            splice(*included, out, spliced);
+        }
+        for (; pos < spans.size(); ++pos) {
+            out.append(spans[pos]);
+        }
+    }
+
+    std::size_t interface_table::size() {
+        std::lock_guard lock(m_mutex);
+        return m_entries.size();
+    }
+
+    preprocessor::preprocessor(const std::string_view filename)
+        : m_owned_table(std::make_unique<interface_table>()), m_table(*m_owned_table) {
+        open(filename);
+    }
+
+    preprocessor::preprocessor(const std::string_view filename, interface_table& table) : m_table(table) {
+        open(filename);
+    }
+
+    preprocessor::preprocessor(interface_entry& entry, interface_table& table)
+        : m_table(table), m_entry(&entry), m_header_only(true) {
+        scan(entry.file.view());
+    }
+
+    void preprocessor::open(const std::string_view filename) {
+        std::string canonical = interface_table::canonicalize(filename);
+        {
+            std::lock_guard lock(m_table.m_mutex);
+            if (const auto it = m_table.m_by_path.find(canonical); it != m_table.m_by_path.end()) {
+                // The interface is already known, but we still need the body, so scan a private copy
+                m_spliced.insert(&interface_table::resolve(*it->second));
+                m_local_entry = std::make_unique<interface_entry>();
+                m_local_entry->path = std::move(canonical);
+                m_entry = m_local_entry.get();
+            } else {
+                m_entry = &m_table.create(std::move(canonical));
+            }
+        }
+        m_entry->file = mapped_file(m_entry->path);
+        m_spliced.insert(m_entry);
+
+        const std::string_view source = m_entry->file.view();
+        scan(source);
+
+        // Included interfaces have been scanning in the background, stitch them in now
+        m_table.wait();
+        if (!m_local_entry) {
+            std::lock_guard lock(m_table.m_mutex);
+            m_entry->hash = interface_table::hash_content(source);
+            m_table.m_by_hash.emplace(m_entry->hash, m_entry);
+        }
+        m_entry->complete = true;
+        m_table.check_cycles(*m_entry);
+        for (const auto& included : m_splices | std::views::values) {
+            m_table.check_cycles(*included);
+        }
+
+        if (!m_splices.empty()) {
+            const source_rope body = std::move(m_rope);
+            m_rope.clear();
+            const auto& spans = body.spans();
+            std::size_t pos = 0;
+            for (const auto& [index, included] : m_splices) {
+                for (; pos < index; ++pos) {
+                    m_rope.append(spans[pos]);
                 }
-                continue;
+                interface_table::splice(*included, m_rope, m_spliced);
+            }
+            for (; pos < spans.size(); ++pos) {
+                m_rope.append(spans[pos]);
             }
-            m_preprocessed_file += m_line + '\n';
+        }
+
+        std::unordered_set<const interface_entry*> header_spliced;
+        interface_table::splice(*m_entry, m_header, header_spliced);
+    }
+
+    void preprocessor::scan(const std::string_view source) {
+        m_source = source;
+        std::size_t pos = 0;
+        while (pos < source.size()) {
+            std::size_t eol = source.find('\n', pos);
+            if (eol == std::string_view::npos) {
+                eol = source.size();
+            }
+            process_line(source.substr(pos, eol - pos));
+            pos = eol + 1;
         }
 
         if (m_in_header_block && m_brace_balance != 0) {
-            throw preprocessor_error("Unclosed header block detected in file: " + std::string(m_filename));
+            throw preprocessor_error("Unclosed header block detected in file: " + m_entry->path);
         }
     }
 
-    std::string& preprocessor::get_preprocessed() noexcept {
+    const source_rope& preprocessor::get_rope() const noexcept {
+        return m_rope;
+    }
+
+    // Flat copies are only built for callers that ask for them
+    std::string& preprocessor::get_preprocessed() {
+        if (m_preprocessed_file.size() != m_rope.size()) {
+            m_preprocessed_file = m_rope.flatten();
+        }
         return m_preprocessed_file;
     }
 
-    std::string& preprocessor::get_header() noexcept {
+    std::string& preprocessor::get_header() {
+        if (m_header_content.size() != m_header.size()) {
+            m_header_content = m_header.flatten();
+        }
         return m_header_content;
     }
 
+    void preprocessor::process_line(const std::string_view line) {
+        // If we detect the start of a header block on this line
+        if (is_header_start(line)) {
+            // We have something like:
+            //   header {
+            // or header { something }
+            // or header { ... multiple braces ... }
+            //
+            // Everything after the first '{' is the start of the block content.
+            const std::size_t start_pos = line.find('{');
+
+            m_in_header_block = true;
+            m_entry->header.clear();
+            m_entry->includes.clear();
+            m_brace_balance = count_braces(line);
+
+            const std::string_view header_line_content = line.substr(start_pos + 1);
+
+            // If the braces on this line already balance out, the block opened and closed on the same line.
+            if (m_brace_balance == 0) {
+                if (const std::size_t closing_brace = header_line_content.find('}'); closing_brace != std::string_view::npos) {
+                    // TODO Trim whitespace ?
+                    emit(header_line_content.substr(0, closing_brace), true);
+                }
+                m_in_header_block = false;
+            } else {
+                emit(header_line_content, true);
+            }
+            return;
+        }
+
+        if (m_in_header_block) {
+            process_header_line(line);
+            return;
+        }
+
+        if (is_define(line)) {
+            // Left in place, macros are expanded on the token stream after lexing
+        } else if (const auto include_path = match_include(line)) {
+            process_include(*include_path, false);
+            return;
+        }
+        emit(line, false);
+    }
+
+    void preprocessor::process_header_line(const std::string_view line) {
+        // Includes inside a header block are re-exported through our own header
+        if (const auto include_path = match_include(line)) {
+            process_include(*include_path, true);
+            return;
+        }
+
+        const int balance_before = m_brace_balance;
+        m_brace_balance += count_braces(line);
+        if (m_brace_balance > 0) {
+            // Block still open
+            emit(line, true);
+            return;
+        }
+
+        // The block closes on this line; find the '}' that brings the balance back to zero
+        // and keep whatever came before it.
+        int local_balance = balance_before;
+        for (std::size_t i = 0; i < line.size(); ++i) {
+            if (line[i] == '{') {
+                local_balance++;
+            } else if (line[i] == '}' && --local_balance == 0) {
+                if (i != 0) {
+                    emit(line.substr(0, i), true);
+                }
+                break;
+            }
+        }
+        m_in_header_block = false;
+    }
+
+    void preprocessor::process_include(const std::string_view include_path, const bool in_header) {
+        // Includes outside the header block of an included file never reach anyone's output
+        if (m_header_only && !in_header) {
+            return;
+        }
+        const interface_entry& included = m_table.request(include_path);
+        if (!m_header_only) {
+            m_splices.emplace_back(m_rope.mark(), &included);
+        }
+        if (in_header) {
+            m_entry->includes.emplace_back(m_entry->header.mark(), &included);
+        }
+    }
+
+    void preprocessor::emit(const std::string_view text, const bool to_header) {
+        // Reuse the line's own terminator while it is still in the buffer, so consecutive lines merge into one span
+        const char* end = text.data() + text.size();
+        const bool has_newline = end < m_source.data() + m_source.size() && *end == '\n';
+        const std::string_view line = has_newline ? std::string_view(text.data(), text.size() + 1) : text;
+        if (!m_header_only) {
+            m_rope.append(line);
+            if (!has_newline) {
+                m_rope.append("\n");
+            }
+        }
+        if (to_header) {
+            m_entry->header.append(line);
+            if (!has_newline) {
+                m_entry->header.append("\n");
+            }
+        }
+    }
+
+    std::string_view preprocessor::skip_whitespace(const std::string_view text) {
+        std::size_t i = 0;
+        while (i < text.size()) {
+            switch (text[i]) {
+                case ' ': case '\t': case '\r': case '\v': case '\f':
+                    ++i;
+                    continue;
+                default:
+                    break;
+            }
+            break;
+        }
+        return text.substr(i);
+    }
+
+    // header\s*{
+    bool preprocessor::is_header_start(std::string_view line) {
+        line = skip_whitespace(line);
+        if (!line.starts_with("header")) {
+            return false;
+        }
+        line = skip_whitespace(line.substr(6));
+        return !line.empty() && line.front() == '{';
+    }
+
+    // define\s+\w+
+    bool preprocessor::is_define(std::string_view line) {
+        line = skip_whitespace(line);
+        if (!line.starts_with("define")) {
+            return false;
+        }
+        line = line.substr(6);
+        const std::string_view rest = skip_whitespace(line);
+        if (rest.size() == line.size() || rest.empty()) {
+            return false;
+        }
+        const char c = rest.front();
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    // include\s*["<](.*)[">], returning the (greedy) path between the delimiters
+    std::optional<std::string_view> preprocessor::match_include(std::string_view line) {
+        line = skip_whitespace(line);
+        if (!line.starts_with("include")) {
+            return std::nullopt;
+        }
+        line = skip_whitespace(line.substr(7));
+        if (line.empty() || (line.front() != '"' && line.front() != '<')) {
+            return std::nullopt;
+        }
+        line = line.substr(1);
+        const std::size_t close = line.find_last_of("\">");
+        if (close == std::string_view::npos) {
+            return std::nullopt;
+        }
+        return line.substr(0, close);
+    }
+
     int preprocessor::count_braces(const std::string_view line) {
         int balance = 0;
         for (const char c : line) {
@@ -179,4 +481,4 @@ namespace ent {
         }
         return balance;
     }
-}
\ No newline at end of file
+}
@@ -6,10 +6,18 @@
 #define PREPROCESSOR_HH
 
 #include "Error.hh"
+#include "Rope.hh"
+#include "ThreadPool.hh"
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string_view>
-#include <fstream>
-#include <set>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 namespace ent {
     class preprocessor_error : public error {
@@ -20,22 +28,128 @@ namespace ent {
     public:
         explicit file_not_found_error(const std::string_view msg) : preprocessor_error(std::format("File not found: {}", msg)) {}
     };
+    class cyclic_include_error final : public preprocessor_error {
+    public:
+        explicit cyclic_include_error(const std::string_view chain) : preprocessor_error(std::format("Cyclic include detected: {}\n", chain)) {}
+    };
+
+    // Read-only mapping of a whole source file; the view stays valid for the lifetime of the object.
+    class mapped_file {
+    public:
+        mapped_file() = default;
+        explicit mapped_file(std::string_view filename);
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        mapped_file(mapped_file&& other) noexcept;
+        mapped_file& operator=(mapped_file&& other) noexcept;
+
+        [[nodiscard]] std::string_view view() const noexcept;
+
+    private:
+        const char* m_data = nullptr;
+        std::size_t m_size = 0;
+    };
+
+    // The exported interface (header block) of one source file, as spans of the mapped file.
+    // Nested includes are not copied in, they are recorded as references together with the
+    // index of the `header` span they splice in front of.
+    struct interface_entry {
+        std::string path;
+        std::uint64_t hash = 0;
+        mapped_file file;
+        source_rope header;
+        std::vector<std::pair<std::size_t, const interface_entry*>> includes;
+        // Set when the file is byte-identical to an entry reached through another path
+        const interface_entry* alias = nullptr;
+        bool complete = false;
+    };
+
+    // Compilation-wide table of scanned interfaces, keyed by canonical path and content hash.
+    // Every file's header block is scanned at most once. Scans run on a worker pool: a scan only
+    // requests the files it includes, and the include graph is stitched and checked for cycles
+    // once the pool has drained, so the output does not depend on scheduling.
+    class interface_table {
+    public:
+        explicit interface_table(unsigned workers = thread_pool::default_workers());
+        interface_table(const interface_table&) = delete;
+        interface_table& operator=(const interface_table&) = delete;
+
+        const interface_entry& load(std::string_view filename);
+
+        // Appends the flattened interface to `out`, skipping every entry already in `spliced`.
+        static void splice(const interface_entry& entry, source_rope& out, std::unordered_set<const interface_entry*>& spliced);
+
+        [[nodiscard]] std::size_t size();
+
+    private:
+        friend class preprocessor;
+
+        static std::string canonicalize(std::string_view filename);
+        static std::uint64_t hash_content(std::string_view content);
+        static const interface_entry& resolve(const interface_entry& entry);
+
+        // Returns the entry for `filename`, scheduling its scan if it has not been seen yet
+        const interface_entry& request(std::string_view filename);
+        void wait();
+        void check_cycles(const interface_entry& root);
+        void check_cycles(const interface_entry& entry, std::vector<const interface_entry*>& stack);
+        void scan(interface_entry& entry);
+
+        interface_entry& create(std::string canonical);
+        [[nodiscard]] interface_entry* find_duplicate(std::uint64_t hash, std::string_view content) const;
+
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<interface_entry>> m_entries;
+        std::unordered_map<std::string, interface_entry*> m_by_path;
+        std::unordered_multimap<std::uint64_t, interface_entry*> m_by_hash;
+        std::unordered_set<const interface_entry*> m_acyclic;
+        thread_pool m_pool;
+    };
+
     class preprocessor {
     public:
         explicit preprocessor(std::string_view filename);
+        preprocessor(std::string_view filename, interface_table& table);
 
-        std::string& get_preprocessed() noexcept;
-        std::string& get_header() noexcept;
+        // The rope borrows from files mapped by this preprocessor and its interface table
+        [[nodiscard]] const source_rope& get_rope() const noexcept;
+        std::string& get_preprocessed();
+        std::string& get_header();
 
     private:
+        friend class interface_table;
+
+        // Header-only scan of an included file, filling `entry`
+        preprocessor(interface_entry& entry, interface_table& table);
+
+        void open(std::string_view filename);
+        void scan(std::string_view source);
+        void process_line(std::string_view line);
+        void process_header_line(std::string_view line);
+        void process_include(std::string_view include_path, bool in_header);
+        void emit(std::string_view text, bool to_header);
+
+        static std::string_view skip_whitespace(std::string_view text);
+        static bool is_header_start(std::string_view line);
+        static bool is_define(std::string_view line);
+        static std::optional<std::string_view> match_include(std::string_view line);
         static int count_braces(std::string_view line);
-        std::string_view m_filename;
-        std::ifstream m_file;
-        std::string m_preprocessed_file;
 
-        std::string m_line;
+        std::unique_ptr<interface_table> m_owned_table;
+        interface_table& m_table;
+        interface_entry* m_entry = nullptr;
+        std::unique_ptr<interface_entry> m_local_entry;
+        bool m_header_only = false;
+        std::string_view m_source;
+
+        source_rope m_rope;
+        source_rope m_header;
+        std::string m_preprocessed_file;
         std::string m_header_content;
-        std::set<std::string_view> m_includes;
+        std::vector<std::pair<std::size_t, const interface_entry*>> m_splices;
+        std::unordered_set<const interface_entry*> m_spliced;
         bool m_in_header_block = false;
         int m_brace_balance = 0;
     };
@@ -0,0 +1,68 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Rope.hh"
+
+namespace ent {
+    void source_rope::append(const std::string_view span) {
+        if (span.empty()) {
+            return;
+        }
+        if (!m_sealed && !m_spans.empty() && m_spans.back().data() + m_spans.back().size() == span.data()) {
+            m_spans.back() = std::string_view(m_spans.back().data(), m_spans.back().size() + span.size());
+        } else {
+            m_spans.push_back(span);
+        }
+        m_sealed = false;
+        m_size += span.size();
+    }
+
+    void source_rope::append(const source_rope& other) {
+        for (const std::string_view span : other.m_spans) {
+            append(span);
+        }
+    }
+
+    std::size_t source_rope::mark() noexcept {
+        m_sealed = true;
+        return m_spans.size();
+    }
+
+    void source_rope::clear() noexcept {
+        m_spans.clear();
+        m_size = 0;
+        m_sealed = false;
+    }
+
+    const std::vector<std::string_view>& source_rope::spans() const noexcept {
+        return m_spans;
+    }
+
+    std::size_t source_rope::size() const noexcept {
+        return m_size;
+    }
+
+    bool source_rope::empty() const noexcept {
+        return m_size == 0;
+    }
+
+    std::string source_rope::flatten() const {
+        std::string text;
+        text.reserve(m_size);
+        for (const std::string_view span : m_spans) {
+            text.append(span);
+        }
+        return text;
+    }
+
+    std::uint64_t source_rope::hash() const noexcept {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (const std::string_view span : m_spans) {
+            for (const char c : span) {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+}
@@ -0,0 +1,40 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef ROPE_HH
+#define ROPE_HH
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ent {
+    // Text assembled from borrowed spans, usually pointing into mapped source files. The rope
+    // never owns its bytes, whoever produced it has to keep the underlying buffers alive.
+    class source_rope {
+    public:
+        // Spans that directly follow the previous one in memory are merged into it
+        void append(std::string_view span);
+        void append(const source_rope& other);
+        // Keeps the next append from merging into the current last span and returns its index,
+        // so callers can remember positions between spans.
+        std::size_t mark() noexcept;
+        void clear() noexcept;
+
+        [[nodiscard]] const std::vector<std::string_view>& spans() const noexcept;
+        [[nodiscard]] std::size_t size() const noexcept;
+        [[nodiscard]] bool empty() const noexcept;
+        [[nodiscard]] std::string flatten() const;
+        // FNV-1a over the text, the same for any split of it into spans
+        [[nodiscard]] std::uint64_t hash() const noexcept;
+
+    private:
+        std::vector<std::string_view> m_spans;
+        std::size_t m_size = 0;
+        bool m_sealed = false;
+    };
+}
+
+#endif //ROPE_HH
@@ -0,0 +1,220 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Scan.hh"
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ENT_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace ent::scan {
+    namespace {
+        bool is_space(const char c) {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        bool is_identifier(const char c) {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+        }
+
+        const char* scalar_skip_whitespace(const char* first, const char* last) {
+            while (first != last && is_space(*first)) { ++first; }
+            return first;
+        }
+
+        const char* scalar_skip_identifier(const char* first, const char* last) {
+            while (first != last && is_identifier(*first)) { ++first; }
+            return first;
+        }
+
+        const char* scalar_find_newline(const char* first, const char* last) {
+            const void* found = std::memchr(first, '\n', last - first);
+            return found ? static_cast<const char*>(found) : last;
+        }
+
+        const char* scalar_find_star(const char* first, const char* last) {
+            const void* found = std::memchr(first, '*', last - first);
+            return found ? static_cast<const char*>(found) : last;
+        }
+
+        const char* scalar_find_string_special(const char* first, const char* last) {
+            while (first != last && *first != '"' && *first != '\\') { ++first; }
+            return first;
+        }
+
+#ifdef ENT_SCAN_X86
+        // Most runs are a few bytes long, shorter than it takes a vector loop to pay off, so the first
+        // bytes always go through the scalar loop and only longer runs reach the vector one
+        constexpr std::ptrdiff_t short_run = 16;
+
+        const char* scan_short(const char*& first, const char* last, const char* (*scalar)(const char*, const char*)) {
+            const char* prefix_end = last - first > short_run ? first + short_run : last;
+            const char* stop = scalar(first, prefix_end);
+            first = prefix_end;
+            return stop != prefix_end || prefix_end == last ? stop : nullptr;
+        }
+
+        // pcmpestri does the classification, 16 bytes at a time; the tail goes through the scalar loop
+        template <int Mode>
+        __attribute__((target("sse4.2")))
+        const char* sse42_scan(const char* first, const char* last, const char* set, const int set_size,
+                               const char* (*tail)(const char*, const char*)) {
+            if (const char* stop = scan_short(first, last, tail)) {
+                return stop;
+            }
+            const __m128i needle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(set));
+            while (last - first >= 16) {
+                const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+                if (const int index = _mm_cmpestri(needle, set_size, chunk, 16, Mode); index != 16) {
+                    return first + index;
+                }
+                first += 16;
+            }
+            return tail(first, last);
+        }
+
+        // Sets are padded to 16 bytes so the needle load stays in bounds
+        constexpr char whitespace_set[16] = {' ', '\t', '\r', '\n'};
+        constexpr char identifier_ranges[16] = {'a', 'z', 'A', 'Z', '0', '9', '_', '_'};
+        constexpr char newline_set[16] = {'\n'};
+        constexpr char star_set[16] = {'*'};
+        constexpr char string_set[16] = {'"', '\\'};
+
+        constexpr int any_of = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT;
+        constexpr int none_of = any_of | _SIDD_NEGATIVE_POLARITY;
+        constexpr int outside_ranges = _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_NEGATIVE_POLARITY | _SIDD_LEAST_SIGNIFICANT;
+
+        const char* sse42_skip_whitespace(const char* first, const char* last) {
+            return sse42_scan<none_of>(first, last, whitespace_set, 4, scalar_skip_whitespace);
+        }
+
+        const char* sse42_skip_identifier(const char* first, const char* last) {
+            return sse42_scan<outside_ranges>(first, last, identifier_ranges, 8, scalar_skip_identifier);
+        }
+
+        const char* sse42_find_newline(const char* first, const char* last) {
+            return sse42_scan<any_of>(first, last, newline_set, 1, scalar_find_newline);
+        }
+
+        const char* sse42_find_star(const char* first, const char* last) {
+            return sse42_scan<any_of>(first, last, star_set, 1, scalar_find_star);
+        }
+
+        const char* sse42_find_string_special(const char* first, const char* last) {
+            return sse42_scan<any_of>(first, last, string_set, 2, scalar_find_string_special);
+        }
+
+        // AVX2 builds a 32-bit mask of the bytes that stop the run and takes its lowest set bit
+        __attribute__((target("avx2")))
+        __m256i avx2_in_range(const __m256i bytes, const char low, const char high) {
+            const __m256i offset = _mm256_sub_epi8(bytes, _mm256_set1_epi8(low));
+            return _mm256_cmpeq_epi8(_mm256_min_epu8(offset, _mm256_set1_epi8(static_cast<char>(high - low))), offset);
+        }
+
+        __attribute__((target("avx2")))
+        __m256i avx2_not_whitespace(const __m256i c) {
+            const __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\t')));
+            const __m256i line = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n')));
+            return _mm256_xor_si256(_mm256_or_si256(space, line), _mm256_set1_epi8(-1));
+        }
+
+        __attribute__((target("avx2")))
+        __m256i avx2_not_identifier(const __m256i c) {
+            // Setting bit 5 folds upper case onto lower case without pulling anything else into a-z
+            const __m256i letter = avx2_in_range(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z');
+            const __m256i digit = avx2_in_range(c, '0', '9');
+            const __m256i underscore = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_'));
+            return _mm256_xor_si256(_mm256_or_si256(_mm256_or_si256(letter, digit), underscore), _mm256_set1_epi8(-1));
+        }
+
+        __attribute__((target("avx2")))
+        __m256i avx2_newline(const __m256i c) {
+            return _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n'));
+        }
+
+        __attribute__((target("avx2")))
+        __m256i avx2_star(const __m256i c) {
+            return _mm256_cmpeq_epi8(c, _mm256_set1_epi8('*'));
+        }
+
+        __attribute__((target("avx2")))
+        __m256i avx2_string_special(const __m256i c) {
+            return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('"')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\\')));
+        }
+
+        template <__m256i (*Stop)(__m256i), const char* (*Tail)(const char*, const char*)>
+        __attribute__((target("avx2,bmi")))
+        const char* avx2_scan(const char* first, const char* last) {
+            if (const char* stop = scan_short(first, last, Tail)) {
+                return stop;
+            }
+            while (last - first >= 32) {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+                if (const auto mask = static_cast<unsigned>(_mm256_movemask_epi8(Stop(chunk)))) {
+                    return first + _tzcnt_u32(mask);
+                }
+                first += 32;
+            }
+            return Tail(first, last);
+        }
+#endif
+
+        constexpr kernels scalar_kernels = {
+            "scalar", scalar_skip_whitespace, scalar_skip_identifier, scalar_find_newline, scalar_find_star, scalar_find_string_special,
+        };
+
+#ifdef ENT_SCAN_X86
+        constexpr kernels sse42_kernels = {
+            "sse4.2", sse42_skip_whitespace, sse42_skip_identifier, sse42_find_newline, sse42_find_star, sse42_find_string_special,
+        };
+
+        constexpr kernels avx2_kernels = {
+            "avx2",
+            avx2_scan<avx2_not_whitespace, scalar_skip_whitespace>,
+            avx2_scan<avx2_not_identifier, scalar_skip_identifier>,
+            avx2_scan<avx2_newline, scalar_find_newline>,
+            avx2_scan<avx2_star, scalar_find_star>,
+            avx2_scan<avx2_string_special, scalar_find_string_special>,
+        };
+#endif
+
+        std::vector<const kernels*> detect() {
+            std::vector<const kernels*> found;
+#ifdef ENT_SCAN_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi")) {
+                found.push_back(&avx2_kernels);
+            }
+            if (__builtin_cpu_supports("sse4.2")) {
+                found.push_back(&sse42_kernels);
+            }
+#endif
+            found.push_back(&scalar_kernels);
+            return found;
+        }
+    }
+
+    const std::vector<const kernels*>& supported() {
+        static const std::vector<const kernels*> found = detect();
+        return found;
+    }
+
+    namespace {
+        std::atomic<const kernels*>& selected() {
+            static std::atomic<const kernels*> set{supported().front()};
+            return set;
+        }
+    }
+
+    const kernels& active() {
+        return *selected().load(std::memory_order_relaxed);
+    }
+
+    void override_active(const kernels& set) {
+        selected().store(&set, std::memory_order_relaxed);
+    }
+}
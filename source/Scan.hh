@@ -0,0 +1,36 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef SCAN_HH
+#define SCAN_HH
+
+#include <string_view>
+#include <vector>
+
+namespace ent::scan {
+    // Scanning kernels for the lexer's hot loops. Each one looks at [first, last) and returns a
+    // pointer to the first character that stops the run, or `last` if nothing did.
+    struct kernels {
+        std::string_view name;
+        // first character that is not ' ', '\t', '\r' or '\n'
+        const char* (*skip_whitespace)(const char* first, const char* last);
+        // first character that is not [A-Za-z0-9_]
+        const char* (*skip_identifier)(const char* first, const char* last);
+        // first '\n'
+        const char* (*find_newline)(const char* first, const char* last);
+        // first '*', for finding the end of a block comment
+        const char* (*find_star)(const char* first, const char* last);
+        // first '"' or '\\'
+        const char* (*find_string_special)(const char* first, const char* last);
+    };
+
+    // Every kernel set the running CPU can execute, widest first; the plain C++ set is always last
+    const std::vector<const kernels*>& supported();
+    // The set lexers pick up when they are built, the widest supported one unless overridden
+    const kernels& active();
+    // Makes lexers built from now on use `set`, so tests and benchmarks can compare every set the CPU runs
+    void override_active(const kernels& set);
+}
+
+#endif //SCAN_HH
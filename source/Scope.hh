@@ -0,0 +1,119 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef SCOPE_HH
+#define SCOPE_HH
+
+#include "Symbol.hh"
+#include <cstdint>
+#include <vector>
+
+namespace ent {
+    // Name to value bindings across nested scopes, in one open-addressing table keyed by symbol_id.
+    // Every name has a single slot holding its innermost binding. Binding over a name from an outer
+    // scope logs what it hid, and closing a scope replays that log backwards, so lookups never scan
+    // scopes and push/pop cost only the bindings the scope made.
+    template <typename Value>
+    class scoped_table {
+    public:
+        void push_scope() {
+            m_scopes.push_back(m_undo.size());
+        }
+
+        void pop_scope() {
+            if (m_scopes.empty()) {
+                return;
+            }
+            for (size_t i = m_undo.size(); i > m_scopes.back(); --i) {
+                const shadowed& previous = m_undo[i - 1];
+                slot& s = m_slots[find(previous.name)];
+                s.value = previous.value;
+                s.depth = previous.depth;
+            }
+            m_undo.resize(m_scopes.back());
+            m_scopes.pop_back();
+        }
+
+        // Binds `name` in the innermost scope, false if no scope is open
+        bool set(const symbol_id name, Value value) {
+            if (m_scopes.empty()) {
+                return false;
+            }
+            if (2 * (m_used + 1) > m_slots.size()) {
+                grow();
+            }
+            slot& s = m_slots[find(name)];
+            const auto depth = static_cast<std::uint32_t>(m_scopes.size());
+            if (s.name == empty) {
+                s.name = name;
+                ++m_used;
+            }
+            // Rebinding within the same scope has nothing to restore
+            if (s.depth != depth) {
+                m_undo.push_back({name, std::move(s.value), s.depth});
+                s.depth = depth;
+            }
+            s.value = std::move(value);
+            return true;
+        }
+
+        // Innermost binding of `name`, nullptr if there is none
+        [[nodiscard]] const Value* get(const symbol_id name) const {
+            if (m_slots.empty()) {
+                return nullptr;
+            }
+            const slot& s = m_slots[find(name)];
+            return s.name == name && s.depth != 0 ? &s.value : nullptr;
+        }
+
+        [[nodiscard]] size_t depth() const noexcept {
+            return m_scopes.size();
+        }
+
+    private:
+        static constexpr symbol_id empty = ~symbol_id{0};
+
+        struct slot {
+            symbol_id name = empty;
+            // Scope that made the binding, 0 once every scope that bound the name is closed
+            std::uint32_t depth = 0;
+            Value value{};
+        };
+
+        struct shadowed {
+            symbol_id name;
+            Value value;
+            std::uint32_t depth;
+        };
+
+        // Slot holding `name`, or the empty slot where it would go. Slots are never freed,
+        // an unbound name keeps its slot at depth 0, so probe chains never break.
+        [[nodiscard]] size_t find(const symbol_id name) const {
+            const size_t mask = m_slots.size() - 1;
+            for (size_t i = (name * 0x9e3779b1u) & mask;; i = (i + 1) & mask) {
+                if (m_slots[i].name == name || m_slots[i].name == empty) {
+                    return i;
+                }
+            }
+        }
+
+        void grow() {
+            std::vector<slot> old = std::move(m_slots);
+            m_slots.assign(old.empty() ? 64 : old.size() * 2, slot{});
+            for (slot& s : old) {
+                if (s.name != empty) {
+                    m_slots[find(s.name)] = std::move(s);
+                }
+            }
+        }
+
+        std::vector<slot> m_slots;
+        size_t m_used = 0;
+        std::vector<shadowed> m_undo;
+        // Size of m_undo when each open scope was pushed
+        std::vector<size_t> m_scopes;
+    };
+}
+
+#endif //SCOPE_HH
@@ -0,0 +1,570 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Serialize.hh"
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace ent::ast {
+    namespace {
+        // "EAST" in memory on a little-endian machine, an image from the other byte order fails here
+        constexpr std::uint32_t magic = 0x54534145;
+        constexpr std::uint32_t node_kinds = static_cast<std::uint32_t>(NODE_TYPE::Binary) + 1;
+        constexpr size_t type_words = 4;
+        constexpr size_t member_words = 2;
+
+        struct header {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint32_t node_kinds;
+            std::uint32_t node_count;
+            std::uint64_t source_hash;
+            std::uint32_t string_count;
+            std::uint32_t string_bytes;
+            std::uint32_t type_count;
+            std::uint32_t member_count;
+            std::uint32_t node_bytes;
+            std::uint32_t padding;
+        };
+        static_assert(sizeof(header) % sizeof(std::uint32_t) == 0, "sections after the header are word aligned");
+
+        size_t padded(const size_t bytes) {
+            return (bytes + sizeof(std::uint32_t) - 1) / sizeof(std::uint32_t) * sizeof(std::uint32_t);
+        }
+
+        header read_header(const std::string_view image) {
+            header h{};
+            if (image.size() < sizeof(header)) {
+                throw module_error("truncated header");
+            }
+            std::memcpy(&h, image.data(), sizeof(header));
+            if (h.magic != magic) {
+                throw module_error("not a module image");
+            }
+            if (h.version != module_version || h.node_kinds != node_kinds) {
+                throw module_error(std::format("written by version {}, expected {}", h.version, module_version));
+            }
+            return h;
+        }
+
+        // Visitor that appends each node after its children and returns the node's record index
+        class writer {
+        public:
+            // Record index of a child, written relative to the record that refers to it
+            struct ref {
+                std::uint32_t index;
+                bool present;
+            };
+
+            ref node(const base_node* n) {
+                return n ? ref{visit(*n, *this), true} : ref{0, false};
+            }
+
+            std::string finish(const std::uint64_t source_hash) const {
+                std::vector<std::uint32_t> ends;
+                std::string bytes;
+                for (const symbol_id id : m_string_ids) {
+                    bytes += symbol_table::name(id);
+                    ends.push_back(static_cast<std::uint32_t>(bytes.size()));
+                }
+                bytes.resize(padded(bytes.size()));
+
+                const header h{magic, module_version, node_kinds, m_node_count, source_hash,
+                               static_cast<std::uint32_t>(ends.size()), static_cast<std::uint32_t>(bytes.size()),
+                               static_cast<std::uint32_t>(m_types.size() / type_words),
+                               static_cast<std::uint32_t>(m_members.size() / member_words),
+                               static_cast<std::uint32_t>(m_bytes.size()), 0};
+                std::string image;
+                image.reserve(sizeof(header) + bytes.size() + 4 * (ends.size() + m_types.size() + m_members.size()) + m_bytes.size());
+                append(image, &h, sizeof(h));
+                append(image, ends.data(), ends.size() * sizeof(std::uint32_t));
+                image += bytes;
+                append(image, m_types.data(), m_types.size() * sizeof(std::uint32_t));
+                append(image, m_members.data(), m_members.size() * sizeof(std::uint32_t));
+                image += m_bytes;
+                return image;
+            }
+
+            std::uint32_t operator()(const program_node& n) {
+                return record(n, list(n.m_elements));
+            }
+            std::uint32_t operator()(const function_prototype_node& n) {
+                return record(n, type(n.m_return_type), name(n.m_name), list(n.m_parameters));
+            }
+            std::uint32_t operator()(const function_node& n) {
+                const auto parameters = list(n.m_parameters);
+                return record(n, type(n.m_return_type), name(n.m_name), parameters, node(n.body()));
+            }
+            std::uint32_t operator()(const body_node& n) {
+                return record(n, list(n.m_statements));
+            }
+            std::uint32_t operator()(const variable_declaration_node& n) {
+                return record(n, name(n.m_name), type(n.m_type));
+            }
+            std::uint32_t operator()(const variable_declaration_assign_node& n) {
+                const ref rhs = node(n.m_rhs);
+                return record(n, name(n.m_name), type(n.m_type), rhs);
+            }
+            std::uint32_t operator()(const assignment_node& n) {
+                const ref rhs = node(n.m_rhs);
+                return record(n, name(n.m_name), rhs);
+            }
+            std::uint32_t operator()(const parameter_node& n) {
+                return record(n, name(n.m_name), type(n.m_type));
+            }
+            std::uint32_t operator()(const expression_node& n) {
+                const ref lhs = node(n.m_lhs);
+                const ref rhs = node(n.m_rhs);
+                return record(n, lhs, static_cast<std::uint32_t>(n.m_op), rhs);
+            }
+            std::uint32_t operator()(const extern_node& n) {
+                return record(n, node(n.m_child));
+            }
+            std::uint32_t operator()(const return_node& n) {
+                return record(n, node(n.m_value));
+            }
+            std::uint32_t operator()(const continue_node& n) {
+                return record(n);
+            }
+            std::uint32_t operator()(const break_node& n) {
+                return record(n);
+            }
+            std::uint32_t operator()(const increment_node& n) {
+                return record(n, name(n.m_name), std::uint32_t{n.m_prefix});
+            }
+            std::uint32_t operator()(const decrement_node& n) {
+                return record(n, name(n.m_name), std::uint32_t{n.m_prefix});
+            }
+            std::uint32_t operator()(const index_assignment_node& n) {
+                const ref index = node(n.m_index);
+                const ref rhs = node(n.m_rhs);
+                return record(n, name(n.m_array_name), index, rhs);
+            }
+            std::uint32_t operator()(const member_invoke_node& n) {
+                const ref base = node(n.m_base);
+                return record(n, base, name(n.m_member_name));
+            }
+            std::uint32_t operator()(const element_call_node& n) {
+                const auto arguments = list(n.m_arguments);
+                const ref base = node(n.m_base);
+                return record(n, name(n.m_callee_name), arguments, base);
+            }
+            std::uint32_t operator()(const if_node& n) {
+                const ref condition = node(n.m_condition);
+                const ref true_body = node(n.m_true_body);
+                const ref false_body = node(n.m_false_body);
+                return record(n, condition, true_body, false_body);
+            }
+            std::uint32_t operator()(const while_node& n) {
+                const ref condition = node(n.m_condition);
+                const ref body = node(n.m_body);
+                return record(n, condition, body);
+            }
+            std::uint32_t operator()(const switch_node& n) {
+                const ref expression = node(n.m_expression);
+                const auto cases = list(n.m_cases);
+                const ref default_case = node(n.m_default_case);
+                return record(n, expression, cases, default_case);
+            }
+            std::uint32_t operator()(const case_node& n) {
+                const ref value = node(n.m_value);
+                const ref body = node(n.m_body);
+                return record(n, value, body);
+            }
+            std::uint32_t operator()(const function_call_node& n) {
+                const auto arguments = list(n.m_arguments);
+                return record(n, name(n.m_name), arguments);
+            }
+            std::uint32_t operator()(const variable_node& n) {
+                return record(n, name(n.m_name));
+            }
+            std::uint32_t operator()(const index_access_node& n) {
+                const ref index = node(n.m_index);
+                return record(n, name(n.m_name), index);
+            }
+            std::uint32_t operator()(const string_literal_node& n) {
+                return record(n, name(n.m_value));
+            }
+            std::uint32_t operator()(const literal_node& n) {
+                return record(n, name(n.m_value), static_cast<std::uint32_t>(n.m_type));
+            }
+            std::uint32_t operator()(const unary_node& n) {
+                return record(n, static_cast<std::uint32_t>(n.m_op), node(n.m_operand));
+            }
+            std::uint32_t operator()(const binary_node& n) {
+                const ref lhs = node(n.m_lhs);
+                const ref rhs = node(n.m_rhs);
+                return record(n, lhs, static_cast<std::uint32_t>(n.m_op), rhs);
+            }
+
+        private:
+            static void append(std::string& image, const void* data, const size_t size) {
+                image.append(static_cast<const char*>(data), size);
+            }
+
+            // Children have to be written before the record that refers to them, so every field is
+            // computed by the caller and the record itself is appended in one go
+            template <typename Node, typename... Fields>
+            std::uint32_t record(const Node&, const Fields&... fields) {
+                put(static_cast<std::uint32_t>(Node::kind));
+                (put(fields), ...);
+                return m_node_count++;
+            }
+
+            // Seven bits at a time, low bits first; most fields fit in one byte
+            void put(std::uint32_t value) {
+                while (value >= 0x80) {
+                    m_bytes.push_back(static_cast<char>(value | 0x80));
+                    value >>= 7;
+                }
+                m_bytes.push_back(static_cast<char>(value));
+            }
+
+            // 0 for none, otherwise how many records back the child is, which is mostly 1 or 2
+            void put(const ref child) {
+                put(child.present ? m_node_count - child.index : 0);
+            }
+
+            void put(const std::vector<ref>& items) {
+                put(static_cast<std::uint32_t>(items.size()));
+                for (const ref item : items) {
+                    put(item);
+                }
+            }
+
+            std::vector<ref> list(const node_list items) {
+                std::vector<ref> indices;
+                indices.reserve(items.size());
+                for (const base_node_ptr item : items) {
+                    indices.push_back(node(item));
+                }
+                return indices;
+            }
+
+            std::uint32_t name(const symbol_id id) {
+                const auto [it, inserted] = m_strings.try_emplace(id, static_cast<std::uint32_t>(m_string_ids.size()));
+                if (inserted) {
+                    m_string_ids.push_back(id);
+                }
+                return it->second;
+            }
+
+            // Type ids are only meaningful within one process, the image numbers its own types.
+            // A record is the kind, then the primitive, the pointee's record or the struct's name.
+            std::uint32_t type(const type_id id) {
+                if (const auto found = m_types_written.find(id); found != m_types_written.end()) {
+                    return found->second;
+                }
+                const type_entry& entry = type_table::get(id);
+                std::uint32_t value = 0;
+                std::vector<std::uint32_t> members;
+                switch (entry.kind) {
+                    case type_kind::Primitive: value = static_cast<std::uint32_t>(entry.primitive); break;
+                    case type_kind::Pointer: value = type(entry.pointee); break;
+                    case type_kind::Struct:
+                        value = name(entry.name);
+                        // Member types may append members of their own, so this struct's go in afterwards
+                        for (const auto& [member, member_type] : entry.members) {
+                            members.push_back(name(member));
+                            members.push_back(type(member_type));
+                        }
+                        break;
+                }
+                const auto first = static_cast<std::uint32_t>(m_members.size() / member_words);
+                m_members.insert(m_members.end(), members.begin(), members.end());
+                const auto index = static_cast<std::uint32_t>(m_types.size() / type_words);
+                m_types.insert(m_types.end(), {static_cast<std::uint32_t>(entry.kind), value, first,
+                                               static_cast<std::uint32_t>(m_members.size() / member_words) - first});
+                m_types_written.emplace(id, index);
+                return index;
+            }
+
+            std::string m_bytes;
+            std::uint32_t m_node_count = 0;
+            std::unordered_map<symbol_id, std::uint32_t> m_strings;
+            std::vector<symbol_id> m_string_ids;
+            std::unordered_map<type_id, std::uint32_t> m_types_written;
+            std::vector<std::uint32_t> m_types;
+            std::vector<std::uint32_t> m_members;
+        };
+
+        // Node kinds a field accepts, one bit per NODE_TYPE
+        using kinds = std::uint32_t;
+        static_assert(static_cast<unsigned>(NODE_TYPE::Binary) < 32, "every node kind has a bit");
+
+        template <typename... Types>
+        constexpr kinds any_of(const Types... types) {
+            return ((kinds{1} << static_cast<unsigned>(types)) | ...);
+        }
+
+        constexpr kinds expressions = any_of(NODE_TYPE::Expression, NODE_TYPE::Binary, NODE_TYPE::Unary, NODE_TYPE::Literal,
+                                             NODE_TYPE::StringLiteral, NODE_TYPE::Variable, NODE_TYPE::FunctionCall,
+                                             NODE_TYPE::ElementCall, NODE_TYPE::MemberInvoke, NODE_TYPE::IndexAccess,
+                                             NODE_TYPE::Assignment, NODE_TYPE::IndexAssignment, NODE_TYPE::Increment,
+                                             NODE_TYPE::Decrement);
+        constexpr kinds statements = expressions | any_of(NODE_TYPE::If, NODE_TYPE::While, NODE_TYPE::Switch, NODE_TYPE::Return,
+                                                          NODE_TYPE::Break, NODE_TYPE::Continue, NODE_TYPE::VariableDeclaration,
+                                                          NODE_TYPE::VariableDeclarationAssign);
+        constexpr kinds declarations = any_of(NODE_TYPE::Function, NODE_TYPE::FunctionPrototype, NODE_TYPE::Extern,
+                                              NODE_TYPE::VariableDeclaration, NODE_TYPE::VariableDeclarationAssign);
+
+        // Every index, enumerator and child kind is checked before use, a damaged image can fail to load
+        // but cannot produce a tree that points outside itself or puts a node where another kind belongs
+        class reader {
+        public:
+            reader(const std::string_view image, arena& nodes) : m_nodes(nodes) {
+                const header h = read_header(image);
+                size_t at = sizeof(header);
+                const auto section = [&](const size_t bytes) {
+                    if (bytes > image.size() - at) {
+                        throw module_error("truncated section");
+                    }
+                    const char* start = image.data() + at;
+                    at += bytes;
+                    return start;
+                };
+                const char* ends = section(size_t{h.string_count} * sizeof(std::uint32_t));
+                const char* bytes = section(h.string_bytes);
+                const char* types = section(size_t{h.type_count} * type_words * sizeof(std::uint32_t));
+                const char* members = section(size_t{h.member_count} * member_words * sizeof(std::uint32_t));
+                m_at = section(h.node_bytes);
+                m_end = m_at + h.node_bytes;
+
+                m_symbols.reserve(h.string_count);
+                for (std::uint32_t i = 0, begin = 0; i < h.string_count; ++i) {
+                    const std::uint32_t end = load(ends, i);
+                    if (end < begin || end > h.string_bytes) {
+                        throw module_error("string out of bounds");
+                    }
+                    m_symbols.push_back(symbol_table::intern(std::string_view(bytes + begin, end - begin)));
+                    begin = end;
+                }
+
+                m_types.reserve(h.type_count);
+                std::vector<struct_member> fields;
+                for (std::uint32_t i = 0; i < h.type_count; ++i) {
+                    const std::uint32_t value = load(types, i * type_words + 1);
+                    switch (static_cast<type_kind>(load(types, i * type_words))) {
+                        case type_kind::Primitive:
+                            if (value > static_cast<std::uint32_t>(primitive_type::SQWord)) {
+                                throw module_error("bad primitive");
+                            }
+                            m_types.push_back(type_table::primitive(static_cast<primitive_type>(value)));
+                            break;
+                        case type_kind::Pointer:
+                            m_types.push_back(type_table::pointer_to(written_type(value, i)));
+                            break;
+                        case type_kind::Struct: {
+                            const std::uint32_t first = load(types, i * type_words + 2);
+                            const std::uint32_t count = load(types, i * type_words + 3);
+                            if (first > h.member_count || count > h.member_count - first) {
+                                throw module_error("type members out of bounds");
+                            }
+                            fields.clear();
+                            for (std::uint32_t m = first; m < first + count; ++m) {
+                                fields.emplace_back(symbol(load(members, m * member_words)), written_type(load(members, m * member_words + 1), i));
+                            }
+                            m_types.push_back(type_table::structure(symbol(value), fields));
+                            break;
+                        }
+                        default:
+                            throw module_error("bad type kind");
+                    }
+                }
+                // Every record takes at least its tag byte, which bounds the count before it sizes anything
+                if (h.node_count > h.node_bytes) {
+                    throw module_error("more nodes than node bytes");
+                }
+                m_node_count = h.node_count;
+                m_built.reserve(m_node_count);
+            }
+
+            base_node_ptr read() {
+                while (m_at != m_end) {
+                    m_built.push_back(read_node());
+                }
+                if (m_built.size() != m_node_count) {
+                    throw module_error("node count does not match the records");
+                }
+                const auto* program = m_built.empty() ? nullptr : node_cast<program_node>(m_built.back());
+                if (!program) {
+                    throw module_error("no program node at the end");
+                }
+                return m_built.back();
+            }
+
+        private:
+            static std::uint32_t load(const char* section, const size_t index) {
+                std::uint32_t word;
+                std::memcpy(&word, section + index * sizeof(std::uint32_t), sizeof(word));
+                return word;
+            }
+
+            static bool flag(const std::uint32_t word) {
+                if (word > 1) {
+                    throw module_error("bad flag");
+                }
+                return word != 0;
+            }
+
+            symbol_id symbol(const std::uint32_t index) const {
+                if (index >= m_symbols.size()) {
+                    throw module_error("string index out of bounds");
+                }
+                return m_symbols[index];
+            }
+
+            std::uint32_t word() {
+                std::uint32_t value = 0;
+                for (int shift = 0; shift < 32; shift += 7) {
+                    if (m_at == m_end) {
+                        throw module_error("truncated node");
+                    }
+                    const auto byte = static_cast<unsigned char>(*m_at++);
+                    value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+                    if (byte < 0x80) {
+                        return value;
+                    }
+                }
+                throw module_error("overlong field");
+            }
+
+            symbol_id name() {
+                return symbol(word());
+            }
+
+            // Types a record refers to always come before it
+            type_id written_type(const std::uint32_t index, const std::uint32_t before) const {
+                if (index >= before) {
+                    throw module_error("type refers forward");
+                }
+                return m_types[index];
+            }
+
+            type_id type() {
+                const std::uint32_t index = word();
+                if (index >= m_types.size()) {
+                    throw module_error("type index out of bounds");
+                }
+                return m_types[index];
+            }
+
+            template <typename Enum>
+            Enum enumerator(const Enum last) {
+                const std::uint32_t value = word();
+                if (value > static_cast<std::uint32_t>(last)) {
+                    throw module_error("bad enumerator");
+                }
+                return static_cast<Enum>(value);
+            }
+
+            // Children are records already read, so the tree can only point backwards
+            base_node_ptr optional_child(const kinds accepted) {
+                const std::uint32_t back = word();
+                if (back == 0) {
+                    return nullptr;
+                }
+                if (back > m_built.size()) {
+                    throw module_error("child index out of bounds");
+                }
+                const base_node_ptr node = m_built[m_built.size() - back];
+                if (!(accepted & any_of(node->type()))) {
+                    throw module_error("child of the wrong kind");
+                }
+                return node;
+            }
+
+            base_node_ptr child(const kinds accepted) {
+                const base_node_ptr node = optional_child(accepted);
+                if (!node) {
+                    throw module_error("missing child");
+                }
+                return node;
+            }
+
+            node_list list(const kinds accepted) {
+                const std::uint32_t count = word();
+                // Every item takes at least a byte
+                if (count > static_cast<size_t>(m_end - m_at)) {
+                    throw module_error("list out of bounds");
+                }
+                if (count == 0) {
+                    return {};
+                }
+                auto* items = static_cast<base_node_ptr*>(m_nodes.allocate(count * sizeof(base_node_ptr), alignof(base_node_ptr)));
+                for (std::uint32_t i = 0; i < count; ++i) {
+                    items[i] = child(accepted);
+                }
+                return {items, count};
+            }
+
+            // Fields come as a braced tuple, which unlike function arguments is evaluated left to right
+            template <typename Node, typename... Fields>
+            base_node_ptr make(std::tuple<Fields...> fields) {
+                return std::apply([this](auto&&... f) -> base_node_ptr { return m_nodes.make<Node>(std::move(f)...); }, std::move(fields));
+            }
+
+            base_node_ptr read_node() {
+                using TOKEN_TYPE = lexer::token::TOKEN_TYPE;
+                constexpr kinds parameters = any_of(NODE_TYPE::Parameter);
+                constexpr kinds body = any_of(NODE_TYPE::Body);
+                switch (enumerator(NODE_TYPE::Binary)) {
+                    case NODE_TYPE::Program: return make<program_node>(std::tuple{list(declarations)});
+                    case NODE_TYPE::FunctionPrototype: return make<function_prototype_node>(std::tuple{type(), name(), list(parameters)});
+                    case NODE_TYPE::Function: return make<function_node>(std::tuple{type(), name(), list(parameters), child(body)});
+                    case NODE_TYPE::Body: return make<body_node>(std::tuple{list(statements)});
+                    case NODE_TYPE::VariableDeclaration: return make<variable_declaration_node>(std::tuple{name(), type()});
+                    case NODE_TYPE::VariableDeclarationAssign: return make<variable_declaration_assign_node>(std::tuple{name(), type(), child(expressions)});
+                    case NODE_TYPE::Assignment: return make<assignment_node>(std::tuple{name(), child(expressions)});
+                    case NODE_TYPE::Parameter: return make<parameter_node>(std::tuple{name(), type()});
+                    case NODE_TYPE::Expression: return make<expression_node>(std::tuple{child(expressions), enumerator(EXPRESSION_NODE_OP::GREATER_EQUAL), child(expressions)});
+                    case NODE_TYPE::Extern: return make<extern_node>(std::tuple{child(any_of(NODE_TYPE::FunctionPrototype, NODE_TYPE::VariableDeclaration))});
+                    case NODE_TYPE::Return: return make<return_node>(std::tuple{optional_child(expressions)});
+                    case NODE_TYPE::Continue: return m_nodes.make<continue_node>();
+                    case NODE_TYPE::Break: return m_nodes.make<break_node>();
+                    case NODE_TYPE::Increment: return make<increment_node>(std::tuple{name(), flag(word())});
+                    case NODE_TYPE::Decrement: return make<decrement_node>(std::tuple{name(), flag(word())});
+                    case NODE_TYPE::IndexAssignment: return make<index_assignment_node>(std::tuple{name(), child(expressions), child(expressions)});
+                    case NODE_TYPE::MemberInvoke: return make<member_invoke_node>(std::tuple{child(expressions), name()});
+                    case NODE_TYPE::ElementCall: return make<element_call_node>(std::tuple{name(), list(expressions), optional_child(expressions)});
+                    case NODE_TYPE::If: return make<if_node>(std::tuple{child(expressions), child(body), optional_child(body | any_of(NODE_TYPE::If))});
+                    case NODE_TYPE::While: return make<while_node>(std::tuple{child(expressions), child(body)});
+                    case NODE_TYPE::Switch: return make<switch_node>(std::tuple{child(expressions), list(any_of(NODE_TYPE::Case)), optional_child(body)});
+                    case NODE_TYPE::Case: return make<case_node>(std::tuple{child(expressions), child(body)});
+                    case NODE_TYPE::FunctionCall: return make<function_call_node>(std::tuple{name(), list(expressions)});
+                    case NODE_TYPE::Variable: return make<variable_node>(std::tuple{name()});
+                    case NODE_TYPE::IndexAccess: return make<index_access_node>(std::tuple{name(), child(expressions)});
+                    case NODE_TYPE::StringLiteral: return make<string_literal_node>(std::tuple{name()});
+                    case NODE_TYPE::Literal: return make<literal_node>(std::tuple{name(), enumerator(literal_node::LITERAL_TYPE::Binary)});
+                    case NODE_TYPE::Unary: return make<unary_node>(std::tuple{enumerator(TOKEN_TYPE::EOFToken), child(expressions)});
+                    case NODE_TYPE::Binary: return make<binary_node>(std::tuple{child(expressions), enumerator(TOKEN_TYPE::EOFToken), child(expressions)});
+                }
+                throw module_error("bad node tag");
+            }
+
+            arena& m_nodes;
+            const char* m_at = nullptr;
+            const char* m_end = nullptr;
+            std::uint32_t m_node_count = 0;
+            std::vector<symbol_id> m_symbols;
+            std::vector<type_id> m_types;
+            std::vector<base_node_ptr> m_built;
+        };
+    }
+
+    std::string serialize(const base_node& program, const std::uint64_t source_hash) {
+        writer w;
+        w.node(&program);
+        return w.finish(source_hash);
+    }
+
+    base_node_ptr deserialize(const std::string_view image, arena& nodes) {
+        return reader(image, nodes).read();
+    }
+
+    std::uint64_t source_hash(const std::string_view image) {
+        return read_header(image).source_hash;
+    }
+}
@@ -0,0 +1,45 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef SERIALIZE_HH
+#define SERIALIZE_HH
+
+#include "AST.icc"
+#include "Error.hh"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace ent {
+    class module_error final : public error {
+    public:
+        explicit module_error(const std::string_view msg) : error(std::format("Unusable module image: {}", msg)) {}
+    };
+}
+
+namespace ent::ast {
+    // Bumped whenever a record changes shape or meaning, older images are then rejected
+    constexpr std::uint32_t module_version = 2;
+
+    // Binary image of a program tree, in native byte order:
+    //   header   magic, version, number of node kinds, hash of the source it was parsed from, section sizes
+    //   strings  every name and literal once, as end offsets followed by the bytes
+    //   types    every type the tree uses once, numbered by the image; pointees and members come
+    //            before the types that refer to them
+    //   nodes    one record per node in post-order: the NODE_TYPE tag, then its fields, all as LEB128.
+    //            Children are the distance back to an earlier record, strings and types indices into
+    //            their sections.
+    // Loading is a single forward pass, nothing in the image is a pointer.
+    // Deferred function bodies are parsed on the way out.
+    std::string serialize(const base_node& program, std::uint64_t source_hash);
+
+    // Rebuilds the tree in `nodes`. The image is only read during the call, so it can be a mapping
+    // that is released right after. Throws module_error if it is truncated, corrupt or from another version.
+    base_node_ptr deserialize(std::string_view image, arena& nodes);
+
+    // Source hash recorded in the header, to tell a stale image from a current one before loading it
+    std::uint64_t source_hash(std::string_view image);
+}
+
+#endif //SERIALIZE_HH
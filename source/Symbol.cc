@@ -0,0 +1,43 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Symbol.hh"
+#include <mutex>
+
+namespace ent {
+    symbol_table::symbol_table() {
+        m_names.emplace_back();
+        m_ids.emplace(std::string_view(), 0);
+    }
+
+    symbol_table& symbol_table::instance() {
+        static symbol_table table;
+        return table;
+    }
+
+    symbol_id symbol_table::intern(const std::string_view name) {
+        symbol_table& table = instance();
+        {
+            std::shared_lock lock(table.m_mutex);
+            if (const auto it = table.m_ids.find(name); it != table.m_ids.end()) {
+                return it->second;
+            }
+        }
+        std::unique_lock lock(table.m_mutex);
+        if (const auto it = table.m_ids.find(name); it != table.m_ids.end()) {
+            return it->second;
+        }
+        // deque never moves its elements, so views into the stored strings stay valid
+        const std::string_view stored = table.m_storage.emplace_back(name);
+        const auto id = static_cast<symbol_id>(table.m_names.size());
+        table.m_names.push_back(stored);
+        table.m_ids.emplace(stored, id);
+        return id;
+    }
+
+    std::string_view symbol_table::name(const symbol_id id) {
+        symbol_table& table = instance();
+        std::shared_lock lock(table.m_mutex);
+        return table.m_names[id];
+    }
+}
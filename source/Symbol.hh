@@ -0,0 +1,37 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef SYMBOL_HH
+#define SYMBOL_HH
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ent {
+    using symbol_id = std::uint32_t;
+
+    // Process-wide string interner. Equal strings always get the same id, id 0 is the empty string,
+    // and names stay valid until the process exits. Safe to use from several threads.
+    class symbol_table {
+    public:
+        static symbol_id intern(std::string_view name);
+        static std::string_view name(symbol_id id);
+
+    private:
+        symbol_table();
+        static symbol_table& instance();
+
+        std::shared_mutex m_mutex;
+        std::deque<std::string> m_storage;
+        std::vector<std::string_view> m_names;
+        std::unordered_map<std::string_view, symbol_id> m_ids;
+    };
+}
+
+#endif //SYMBOL_HH
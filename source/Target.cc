@@ -0,0 +1,107 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Target.hh"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/TargetParser/Host.h>
+#include <format>
+#include <optional>
+#include <stdexcept>
+
+namespace ent {
+    namespace {
+        // The host does not change while the process runs, so it is asked once
+        const target_options& host() {
+            static const target_options resolved = [] {
+                target_options options;
+                options.cpu = llvm::sys::getHostCPUName().str();
+                llvm::StringMap<bool> host_features;
+                if (!llvm::sys::getHostCPUFeatures(host_features)) {
+                    return options;
+                }
+                for (const llvm::StringMapEntry<bool>& feature : host_features) {
+                    options.features += std::format("{}{},", feature.getValue() ? '+' : '-', feature.getKey().str());
+                }
+                if (!options.features.empty()) {
+                    options.features.pop_back();
+                }
+                return options;
+            }();
+            return resolved;
+        }
+
+        void use_host(target_options& options) {
+            options.cpu = host().cpu;
+            if (!host().features.empty()) {
+                options.features = host().features;
+            }
+        }
+    }
+
+    bool parse_target_flag(const std::string_view flag, target_options& options) {
+        for (const std::string_view prefix : {"-march=", "-mcpu="}) {
+            if (flag.starts_with(prefix)) {
+                const std::string_view cpu = flag.substr(prefix.size());
+                if (cpu == "native") {
+                    use_host(options);
+                } else {
+                    options.cpu = std::string(cpu);
+                }
+                return true;
+            }
+        }
+        if (flag.starts_with("-mattr=")) {
+            if (!options.features.empty()) {
+                options.features += ',';
+            }
+            options.features += flag.substr(std::string_view("-mattr=").size());
+            return true;
+        }
+        return false;
+    }
+
+    target_cache& target_cache::instance() {
+        static target_cache cache;
+        return cache;
+    }
+
+    void target_cache::initialize() {
+        static std::once_flag once;
+        std::call_once(once, [] {
+            llvm::InitializeAllTargetInfos();
+            llvm::InitializeAllTargets();
+            llvm::InitializeAllTargetMCs();
+            llvm::InitializeAllAsmPrinters();
+            llvm::InitializeAllAsmParsers();
+        });
+    }
+
+    std::unique_ptr<llvm::TargetMachine> target_cache::machine(const target_options& options, const llvm::CodeGenOptLevel level) {
+        initialize();
+        const std::string triple = options.triple.empty() ? llvm::sys::getProcessTriple() : options.triple;
+
+        const llvm::Target* target = nullptr;
+        {
+            target_cache& cache = instance();
+            const std::scoped_lock lock(cache.m_mutex);
+            if (const auto found = cache.m_targets.find(triple); found != cache.m_targets.end()) {
+                target = found->second;
+            } else {
+                std::string error;
+                target = llvm::TargetRegistry::lookupTarget(triple, error);
+                if (!target) {
+                    throw std::runtime_error("Failed to lookup target: " + error);
+                }
+                cache.m_targets.emplace(triple, target);
+            }
+        }
+        std::unique_ptr<llvm::TargetMachine> machine(target->createTargetMachine(
+            triple, options.cpu, options.features, llvm::TargetOptions(), llvm::Reloc::Model::PIC_, std::nullopt, level));
+        if (!machine) {
+            throw std::runtime_error("Failed to create target machine");
+        }
+        return machine;
+    }
+}
@@ -0,0 +1,46 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef TARGET_HH
+#define TARGET_HH
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <llvm/Support/CodeGen.h>
+#include <llvm/Target/TargetMachine.h>
+
+namespace ent {
+    struct target_options {
+        // Empty for the triple of the running process
+        std::string triple;
+        std::string cpu = "generic";
+        // Comma separated, "+avx2,-sse4a"
+        std::string features;
+    };
+
+    // Applies -march=, -mcpu= or -mattr= to `options`, false if `flag` is none of them. "native"
+    // as the architecture or CPU selects the host CPU and every feature it reports.
+    bool parse_target_flag(std::string_view flag, target_options& options);
+
+    // Process-wide target lookup. LLVM's targets are registered once for the whole process and each
+    // triple is looked up in the registry once. Machines are not shared: building passes on one
+    // fills its subtarget map and resets its options, so every caller gets a machine of its own.
+    class target_cache {
+    public:
+        static void initialize();
+        static std::unique_ptr<llvm::TargetMachine> machine(const target_options& options, llvm::CodeGenOptLevel level);
+
+    private:
+        target_cache() = default;
+        static target_cache& instance();
+
+        std::mutex m_mutex;
+        std::unordered_map<std::string, const llvm::Target*> m_targets;
+    };
+}
+
+#endif //TARGET_HH
@@ -0,0 +1,86 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "ThreadPool.hh"
+#include <utility>
+
+namespace ent {
+    thread_pool::thread_pool(const unsigned workers) {
+        m_workers.reserve(workers);
+        for (unsigned i = 0; i < workers; ++i) {
+            m_workers.emplace_back([this](const std::stop_token& stop) { worker_loop(stop); });
+        }
+    }
+
+    thread_pool::~thread_pool() {
+        for (auto& worker : m_workers) {
+            worker.request_stop();
+        }
+        m_work_available.notify_all();
+        // jthread joins on destruction
+    }
+
+    void thread_pool::submit(std::function<void()> task) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_work_available.notify_one();
+    }
+
+    void thread_pool::wait() {
+        std::unique_lock lock(m_mutex);
+        while (true) {
+            if (!m_tasks.empty()) {
+                run(lock);
+                continue;
+            }
+            if (m_in_flight == 0) {
+                break;
+            }
+            m_idle.wait(lock);
+        }
+        if (m_error) {
+            std::rethrow_exception(std::exchange(m_error, nullptr));
+        }
+    }
+
+    unsigned thread_pool::size() const noexcept {
+        return static_cast<unsigned>(m_workers.size());
+    }
+
+    unsigned thread_pool::default_workers() noexcept {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        return hardware > 1 ? hardware - 1 : 0;
+    }
+
+    void thread_pool::worker_loop(const std::stop_token& stop) {
+        std::unique_lock lock(m_mutex);
+        while (m_work_available.wait(lock, stop, [this] { return !m_tasks.empty(); })) {
+            run(lock);
+        }
+    }
+
+    // Pops one task and runs it with the lock released; called with the lock held and a non-empty queue
+    void thread_pool::run(std::unique_lock<std::mutex>& lock) {
+        auto task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+        ++m_in_flight;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (error && !m_error) {
+            m_error = error;
+        }
+        if (--m_in_flight == 0 && m_tasks.empty()) {
+            m_idle.notify_all();
+        }
+    }
+}
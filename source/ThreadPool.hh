@@ -0,0 +1,50 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef THREADPOOL_HH
+#define THREADPOOL_HH
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ent {
+    // Fixed set of worker threads draining one FIFO queue. The thread calling wait() helps drain
+    // the queue too, so a pool with zero workers simply runs everything inside wait().
+    class thread_pool {
+    public:
+        explicit thread_pool(unsigned workers);
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        void submit(std::function<void()> task);
+        // Returns once every task submitted so far (including ones they submitted) has finished,
+        // rethrowing the first exception any of them raised.
+        void wait();
+
+        [[nodiscard]] unsigned size() const noexcept;
+        // Worker count that, together with the calling thread, uses every hardware thread
+        static unsigned default_workers() noexcept;
+
+    private:
+        void worker_loop(const std::stop_token& stop);
+        void run(std::unique_lock<std::mutex>& lock);
+
+        std::mutex m_mutex;
+        std::condition_variable_any m_work_available;
+        std::condition_variable m_idle;
+        std::deque<std::function<void()>> m_tasks;
+        std::size_t m_in_flight = 0;
+        std::exception_ptr m_error;
+        std::vector<std::jthread> m_workers;
+    };
+}
+
+#endif //THREADPOOL_HH
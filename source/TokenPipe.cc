@@ -0,0 +1,79 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "TokenPipe.hh"
+#include <utility>
+
+namespace ent {
+    token_pipe::token_pipe(token_source upstream, const size_t chunk_size, const size_t max_chunks)
+        : m_upstream(std::move(upstream)), m_chunk_size(chunk_size), m_max_chunks(max_chunks),
+          m_producer([this](const std::stop_token& stop) { produce(stop); }) {}
+
+    token_pipe::~token_pipe() {
+        m_producer.request_stop();
+        m_not_full.notify_all();
+        // jthread joins on destruction
+    }
+
+    void token_pipe::produce(const std::stop_token& stop) {
+        std::vector<lexer::token> chunk;
+        try {
+            while (!stop.stop_requested()) {
+                chunk.reserve(m_chunk_size);
+                while (chunk.size() < m_chunk_size) {
+                    chunk.push_back(m_upstream());
+                    if (chunk.back().type == lexer::token::TOKEN_TYPE::EOFToken) {
+                        publish(chunk, stop);
+                        return;
+                    }
+                }
+                if (!publish(chunk, stop)) {
+                    return;
+                }
+            }
+        } catch (...) {
+            // Tokens lexed before the error still reach the parser first
+            publish(chunk, stop);
+            std::lock_guard lock(m_mutex);
+            m_error = std::current_exception();
+            m_finished = true;
+            m_not_empty.notify_one();
+        }
+    }
+
+    bool token_pipe::publish(std::vector<lexer::token>& chunk, const std::stop_token& stop) {
+        std::unique_lock lock(m_mutex);
+        if (!m_not_full.wait(lock, stop, [this] { return m_chunks.size() < m_max_chunks; })) {
+            return false;
+        }
+        const bool last = !chunk.empty() && chunk.back().type == lexer::token::TOKEN_TYPE::EOFToken;
+        if (!chunk.empty()) {
+            m_chunks.push_back(std::exchange(chunk, {}));
+        }
+        m_finished = m_finished || last;
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    lexer::token token_pipe::pull() {
+        if (m_next < m_chunk.size()) {
+            return m_chunk[m_next++];
+        }
+        // The EOF token is handed out again for every pull after the end
+        if (!m_chunk.empty() && m_chunk.back().type == lexer::token::TOKEN_TYPE::EOFToken) {
+            return m_chunk.back();
+        }
+        std::unique_lock lock(m_mutex);
+        m_not_empty.wait(lock, [this] { return !m_chunks.empty() || m_finished; });
+        if (m_chunks.empty()) {
+            std::rethrow_exception(m_error);
+        }
+        m_chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        m_not_full.notify_one();
+        lock.unlock();
+
+        m_next = 1;
+        return m_chunk.front();
+    }
+}
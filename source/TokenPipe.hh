@@ -0,0 +1,56 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef TOKENPIPE_HH
+#define TOKENPIPE_HH
+
+#include "Lexer.hh"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ent {
+    // Runs a token source on its own thread and hands the tokens over in fixed-size chunks through
+    // a bounded queue, so lexing and macro expansion overlap with parsing while no more than
+    // `max_chunks` chunks are ever buffered. An exception thrown upstream is rethrown by pull()
+    // once every token produced before it has been handed out.
+    class token_pipe {
+    public:
+        explicit token_pipe(token_source upstream, size_t chunk_size = 1024, size_t max_chunks = 4);
+        ~token_pipe();
+
+        token_pipe(const token_pipe&) = delete;
+        token_pipe& operator=(const token_pipe&) = delete;
+
+        lexer::token pull();
+
+    private:
+        void produce(const std::stop_token& stop);
+        // Hands a full (or final) chunk to the consumer, false if the pipe is shutting down
+        bool publish(std::vector<lexer::token>& chunk, const std::stop_token& stop);
+
+        token_source m_upstream;
+        const size_t m_chunk_size;
+        const size_t m_max_chunks;
+
+        std::mutex m_mutex;
+        std::condition_variable_any m_not_full;
+        std::condition_variable m_not_empty;
+        std::deque<std::vector<lexer::token>> m_chunks;
+        bool m_finished = false;
+        std::exception_ptr m_error;
+
+        // Consumer side only
+        std::vector<lexer::token> m_chunk;
+        size_t m_next = 0;
+
+        // Last, so the producer is stopped and joined before anything it touches goes away
+        std::jthread m_producer;
+    };
+}
+
+#endif //TOKENPIPE_HH
@@ -0,0 +1,123 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+#include "Type.hh"
+#include <format>
+#include <mutex>
+
+namespace ent {
+    namespace {
+        struct primitive_info {
+            std::string_view keyword;
+            std::string_view mangled;
+        };
+
+        constexpr primitive_info primitives[] = {
+            {"void", "v"}, {"byte", "b"}, {"word", "w"}, {"dword", "d"}, {"qword", "q"},
+            {"sbyte", "B"}, {"sword", "W"}, {"sdword", "D"}, {"sqword", "Q"},
+        };
+
+        // Innermost type behind any number of pointers, and how many there are
+        std::pair<const type_entry*, int> strip_pointers(const type_entry* entry) {
+            int depth = 0;
+            while (entry->kind == type_kind::Pointer) {
+                entry = &type_table::get(entry->pointee);
+                ++depth;
+            }
+            return {entry, depth};
+        }
+
+        std::string describe_base(const type_entry& base, const int depth) {
+            if (base.kind == type_kind::Primitive) {
+                return std::format("base_type: {}, pointer: {}, is_struct: false", primitives[static_cast<size_t>(base.primitive)].keyword, depth);
+            }
+            std::string text = std::format("base_type: {}, pointer: {}, is_struct: true", symbol_table::name(base.name), depth);
+            if (!base.members.empty()) {
+                text += ", struct_values: {";
+                for (const auto& [member, type] : base.members) {
+                    text += std::format("{{{}: {}}}, ", symbol_table::name(member), type_table::describe(type));
+                }
+                text.resize(text.size() - 2);
+                text += "}";
+            }
+            return text;
+        }
+    }
+
+    type_table::type_table() {
+        for (size_t i = 0; i < std::size(primitives); ++i) {
+            const auto p = static_cast<primitive_type>(i);
+            type_entry entry{type_kind::Primitive, p, 0, 0, {}, std::string(primitives[i].mangled), ""};
+            entry.description = describe_base(entry, 0);
+            add(std::move(entry));
+        }
+    }
+
+    type_table& type_table::instance() {
+        static type_table table;
+        return table;
+    }
+
+    type_id type_table::add(type_entry entry) {
+        const auto id = static_cast<type_id>(m_entries.size());
+        m_entries.push_back(std::move(entry));
+        return id;
+    }
+
+    type_id type_table::pointer_to(const type_id pointee) {
+        type_table& table = instance();
+        {
+            std::shared_lock lock(table.m_mutex);
+            if (const auto it = table.m_pointers.find(pointee); it != table.m_pointers.end()) {
+                return it->second;
+            }
+        }
+        const auto [base, depth] = strip_pointers(&get(pointee));
+        type_entry entry{type_kind::Pointer, primitive_type::Void, pointee, 0, {}, "P" + std::string(mangled(pointee)), describe_base(*base, depth + 1)};
+        std::unique_lock lock(table.m_mutex);
+        const auto [it, inserted] = table.m_pointers.try_emplace(pointee);
+        if (inserted) {
+            it->second = table.add(std::move(entry));
+        }
+        return it->second;
+    }
+
+    type_id type_table::structure(const symbol_id name, const std::span<const struct_member> members) {
+        type_table& table = instance();
+        // Members are part of the identity, two layouts under one name are two types
+        std::string key = std::format("{}", name);
+        for (const auto& [member, type] : members) {
+            key += std::format(",{}:{}", member, type);
+        }
+        {
+            std::shared_lock lock(table.m_mutex);
+            if (const auto it = table.m_structs.find(key); it != table.m_structs.end()) {
+                return it->second;
+            }
+        }
+        const std::string_view spelled = symbol_table::name(name);
+        type_entry entry{type_kind::Struct, primitive_type::Void, 0, name, {members.begin(), members.end()},
+                         std::format("S{}{}", spelled.size(), spelled), ""};
+        entry.description = describe_base(entry, 0);
+        std::unique_lock lock(table.m_mutex);
+        const auto [it, inserted] = table.m_structs.try_emplace(std::move(key));
+        if (inserted) {
+            it->second = table.add(std::move(entry));
+        }
+        return it->second;
+    }
+
+    const type_entry& type_table::get(const type_id id) {
+        type_table& table = instance();
+        std::shared_lock lock(table.m_mutex);
+        return table.m_entries[id];
+    }
+
+    std::string_view type_table::mangled(const type_id id) {
+        return get(id).mangled;
+    }
+
+    std::string_view type_table::describe(const type_id id) {
+        return get(id).description;
+    }
+}
@@ -0,0 +1,74 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef TYPE_HH
+#define TYPE_HH
+
+#include "Symbol.hh"
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ent {
+    using type_id = std::uint32_t;
+
+    // In keyword order, the id of each primitive is its enumerator
+    enum class primitive_type : std::uint8_t { Void, Byte, Word, DWord, QWord, SByte, SWord, SDWord, SQWord };
+
+    enum class type_kind : std::uint8_t { Primitive, Pointer, Struct };
+
+    using struct_member = std::pair<symbol_id, type_id>;
+
+    struct type_entry {
+        type_kind kind;
+        primitive_type primitive;
+        // Pointer only: the type pointed to
+        type_id pointee;
+        // Struct only
+        symbol_id name;
+        std::vector<struct_member> members;
+        // Worked out once when the type is interned
+        std::string mangled;
+        std::string description;
+    };
+
+    // Process-wide table of every type, hash-consed so that two types are the same exactly when
+    // their ids are. Entries never move and live until the process exits. Safe to use from several threads.
+    class type_table {
+    public:
+        static constexpr type_id primitive(const primitive_type p) noexcept {
+            return static_cast<type_id>(p);
+        }
+        static type_id pointer_to(type_id pointee);
+        static type_id structure(symbol_id name, std::span<const struct_member> members);
+
+        static const type_entry& get(type_id id);
+        // Suffix the type contributes to a mangled function name
+        static std::string_view mangled(type_id id);
+        // Readable form, as the AST dump prints it
+        static std::string_view describe(type_id id);
+
+    private:
+        type_table();
+        static type_table& instance();
+
+        // Appends a new entry, the caller holds the lock and has checked it is not there yet
+        type_id add(type_entry entry);
+
+        std::shared_mutex m_mutex;
+        std::deque<type_entry> m_entries;
+        // Pointee to pointer type
+        std::unordered_map<type_id, type_id> m_pointers;
+        // Struct name and members, spelled out, to struct type
+        std::unordered_map<std::string, type_id> m_structs;
+    };
+}
+
+#endif //TYPE_HH
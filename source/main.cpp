@@ -1,20 +1,98 @@
 #include <print>
+#include <filesystem>
 #include <fstream>
+#include <memory>
 #include "Lexer.hh"
+#include "Macro.hh"
 #include "Parser.hh"
 #include "AST.icc"
 #include "Preprocessor.hh"
+#include "Serialize.hh"
+#include "TokenPipe.hh"
 
-void test_parser_with_file(const std::string& file_path) {
-    std::print("Parsing file: {}\n", file_path);
+ent::ast::base_node_ptr parse_file(const ent::preprocessor& pp, ent::arena& nodes) {
+    ent::lexer lexer(pp.get_rope());
+    ent::macro_expander macros(std::move(lexer.get_tokens()), lexer.get_lines());
+    ent::parser parser(std::move(macros.get_tokens()), std::move(lexer.get_lines()), nodes);
+    return parser.parse_program();
+}
+
+// Lexing and macro expansion run on a second thread, token memory stays bounded however large the file is
+ent::ast::base_node_ptr parse_file_streaming(const ent::preprocessor& pp, ent::arena& nodes) {
+    const ent::line_index lines(pp.get_rope().spans());
+    ent::lexer lexer(pp.get_rope(), ent::lexer::streaming);
+    ent::macro_expander macros([&lexer] { return lexer.pull(); }, lines);
+    ent::token_pipe pipe([&macros] { return macros.pull(); });
+    ent::parser parser([&pipe] { return pipe.pull(); }, lines, nodes);
+    return parser.parse_program();
+}
+
+// Top-level declarations are parsed in batches on the pool
+ent::ast::base_node_ptr parse_file_parallel(const ent::preprocessor& pp, ent::arena& nodes, ent::thread_pool& pool) {
+    ent::lexer lexer(pp.get_rope());
+    ent::macro_expander macros(std::move(lexer.get_tokens()), lexer.get_lines());
+    return ent::parser::parse_program_parallel(std::move(macros.get_tokens()), std::move(lexer.get_lines()), nodes, pool);
+}
+
+// Loads `<file>.ast` when it was written for the same preprocessed source, otherwise parses and rewrites it
+ent::ast::base_node_ptr parse_file_cached(const ent::preprocessor& pp, const std::string& file_path, ent::arena& nodes) {
+    const std::string cache_path = file_path + ".ast";
+    const std::uint64_t hash = pp.get_rope().hash();
+    if (std::filesystem::exists(cache_path)) {
+        const ent::mapped_file image(cache_path);
+        try {
+            if (ent::ast::source_hash(image.view()) == hash) {
+                return ent::ast::deserialize(image.view(), nodes);
+            }
+        } catch (const ent::module_error&) {
+            // Another version wrote it, or it is damaged; overwritten below
+        }
+    }
+    const ent::ast::base_node_ptr ast = parse_file(pp, nodes);
+    std::ofstream(cache_path, std::ios::binary) << ent::ast::serialize(*ast, hash);
+    return ast;
+}
+
+// Signatures and globals, without ever parsing a function body
+void print_outline(const ent::preprocessor& pp, ent::arena& nodes) {
+    ent::lexer lexer(pp.get_rope());
+    ent::macro_expander macros(std::move(lexer.get_tokens()), lexer.get_lines());
+    const ent::outline outline(std::move(macros.get_tokens()), std::move(lexer.get_lines()), nodes);
+    for (const ent::ast::base_node_ptr element : ent::ast::node_cast<ent::ast::program_node>(outline.program())->m_elements) {
+        const auto* function = ent::ast::node_cast<ent::ast::function_node>(element);
+        if (!function) {
+            element->print(0);
+            continue;
+        }
+        std::print("Function {} -> {}\n", function->name(), ent::type_table::describe(function->return_type()));
+        for (const ent::ast::base_node_ptr parameter : function->parameters()) {
+            parameter->print(4);
+        }
+    }
+}
 
-    ent::preprocessor pp(file_path);
-    const auto source = pp.get_preprocessed();
-    ent::lexer lexer(source);
-    const auto tokens = lexer.get_tokens();
-    ent::parser parser(tokens);
+enum class parse_mode { batch, streaming, parallel, outline, cached };
 
-    const auto ast = parser.parse_program();
+void test_parser_with_file(const std::string& file_path, ent::interface_table& interfaces, const parse_mode mode,
+                           ent::thread_pool* pool) {
+    std::print("Parsing file: {}\n", file_path);
+
+    const ent::preprocessor pp(file_path, interfaces);
+    // Everything the file's AST is made of, released in one go when the file is done
+    ent::arena nodes;
+    if (mode == parse_mode::outline) {
+        std::print("Outline of {}:\n", file_path);
+        print_outline(pp, nodes);
+        return;
+    }
+    ent::ast::base_node_ptr ast = nullptr;
+    switch (mode) {
+        case parse_mode::batch: ast = parse_file(pp, nodes); break;
+        case parse_mode::streaming: ast = parse_file_streaming(pp, nodes); break;
+        case parse_mode::parallel: ast = parse_file_parallel(pp, nodes, *pool); break;
+        case parse_mode::cached: ast = parse_file_cached(pp, file_path, nodes); break;
+        case parse_mode::outline: break;
+    }
     if (ast) {
         std::print("AST for {}:\n", file_path);
         ast->print(0);
@@ -28,12 +106,35 @@ void test_parser_with_file(const std::string& file_path) {
 
 int main(const int argc, char* argv[]) {
     if (argc < 2) {
-        std::print("Usage: {} <test files...>\n", argv[0]);
+        std::print("Usage: {} [--stream | --parallel | --outline | --cache] <test files...>\n", argv[0]);
         return 1;
     }
 
+    ent::interface_table interfaces;
+    // Only started once --parallel asks for it
+    std::unique_ptr<ent::thread_pool> pool;
+    parse_mode mode = parse_mode::batch;
     for (int i = 1; i < argc; ++i) {
-        test_parser_with_file(argv[i]);
+        if (std::string_view(argv[i]) == "--stream") {
+            mode = parse_mode::streaming;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--cache") {
+            mode = parse_mode::cached;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--outline") {
+            mode = parse_mode::outline;
+            continue;
+        }
+        if (std::string_view(argv[i]) == "--parallel") {
+            mode = parse_mode::parallel;
+            if (!pool) {
+                pool = std::make_unique<ent::thread_pool>(ent::thread_pool::default_workers());
+            }
+            continue;
+        }
+        test_parser_with_file(argv[i], interfaces, mode, pool.get());
     }
 
     std::print("All tests completed.\n");
@@ -0,0 +1,64 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+
+#ifndef CHECK_HH
+#define CHECK_HH
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <print>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+
+namespace ent::test {
+    inline int failures = 0;
+
+    inline void check(const bool ok, const std::string_view what) {
+        if (!ok) {
+            ++failures;
+            std::print(stderr, "FAILED: {}\n", what);
+        }
+    }
+
+    // Exit status for main
+    inline int result() {
+        if (failures == 0) {
+            std::print("all checks passed\n");
+        }
+        return failures == 0 ? 0 : 1;
+    }
+
+    // What `body` writes to stdout, such as the print() of a tree
+    template <typename Body>
+    std::string captured_stdout(Body&& body) {
+        std::fflush(stdout);
+        FILE* capture = std::tmpfile();
+        const int saved = dup(STDOUT_FILENO);
+        dup2(fileno(capture), STDOUT_FILENO);
+        body();
+        std::fflush(stdout);
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+        std::rewind(capture);
+        std::string text;
+        char buffer[4096];
+        for (size_t read; (read = std::fread(buffer, 1, sizeof(buffer), capture)) > 0;) {
+            text.append(buffer, read);
+        }
+        std::fclose(capture);
+        return text;
+    }
+
+    inline std::string read_file(const std::filesystem::path& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::ostringstream text;
+        text << in.rdbuf();
+        return text.str();
+    }
+}
+
+#endif //CHECK_HH
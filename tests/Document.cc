@@ -0,0 +1,113 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Applies random edits to a document and checks every result against a document built from scratch
+// on the same text: the same tokens and tree when the edit parses, the same error when it does not.
+#include "Check.hh"
+#include "Document.hh"
+#include "Preprocessor.hh"
+#include <random>
+
+namespace {
+    struct state {
+        std::string error;
+        std::vector<ent::lexer::token> tokens;
+        std::string tree;
+    };
+
+    state capture(const ent::document& doc) {
+        return {{}, doc.tokens(), ent::test::captured_stdout([&doc] { doc.program()->print(0); })};
+    }
+
+    state rebuilt(const std::string& text) {
+        try {
+            return capture(ent::document(text));
+        } catch (const ent::generic_error& e) {
+            return {e.what(), {}, {}};
+        }
+    }
+
+    bool same_tokens(const std::vector<ent::lexer::token>& a, const std::vector<ent::lexer::token>& b) {
+        return std::ranges::equal(a, b, [](const ent::lexer::token& x, const ent::lexer::token& y) {
+            return x.type == y.type && x.offset == y.offset && x.length == y.length && x.symbol == y.symbol
+                && x.first_on_line == y.first_on_line;
+        });
+    }
+
+    class checker {
+    public:
+        explicit checker(std::string text) : m_doc(std::move(text)) {}
+
+        // Applies the edit and compares with a rebuild, returning whether it parsed
+        bool edit(const size_t offset, const size_t removed, const std::string_view inserted) {
+            state incremental;
+            try {
+                m_doc.edit(offset, removed, inserted);
+                incremental = capture(m_doc);
+            } catch (const ent::generic_error& e) {
+                incremental.error = e.what();
+            }
+            const state expected = rebuilt(m_doc.text());
+            const std::string what = std::format("edit {}: {} characters at {} replaced by \"{}\"", m_edits++, removed, offset, inserted);
+            ent::test::check(incremental.error == expected.error,
+                             std::format("{}: error \"{}\", rebuild says \"{}\"", what, incremental.error, expected.error));
+            ent::test::check(same_tokens(incremental.tokens, expected.tokens), what + ": tokens differ from a rebuild");
+            ent::test::check(incremental.tree == expected.tree, what + ": tree differs from a rebuild");
+            return expected.error.empty();
+        }
+
+        [[nodiscard]] const std::string& text() const noexcept { return m_doc.text(); }
+
+    private:
+        ent::document m_doc;
+        size_t m_edits = 0;
+    };
+
+    // Comments and strings opened in one declaration and closed several declarations later
+    void check_spanning(const std::string& text) {
+        checker doc(text);
+        const size_t open = text.find("fn ");
+        const size_t close = text.rfind("};");
+        ent::test::check(!doc.edit(open, 0, "/*"), "an unclosed block comment must fail");
+        doc.edit(close + 4, 0, "*/");
+        doc.edit(close + 4, 2, "");
+        doc.edit(open, 2, "");
+        ent::test::check(!doc.edit(open, 0, "byte* s = \""), "an unclosed string must fail");
+        doc.edit(close + 13, 0, "\";\n");
+        doc.edit(open, 11, "");
+    }
+
+    void check_random(const std::string& text) {
+        constexpr std::string_view snippets[] = {
+            "", "x", "7", " ", "\n", ";", "{", "}", "(", ")", "=", "/*", "*/", "\"", "// note\n", "\"a /* b\"",
+            "/* \" */", "fn g(word a) -> word { return a; };\n", "dword z = 3;\n",
+        };
+        checker doc(text);
+        std::mt19937 random(11);
+        size_t parsed = 0;
+        size_t failed = 0;
+        for (int round = 0; round < 3000; ++round) {
+            const size_t offset = random() % (doc.text().size() + 1);
+            const size_t removed = std::min<size_t>(random() % 6, doc.text().size() - offset);
+            const std::string_view inserted = snippets[random() % std::size(snippets)];
+            const std::string previous = doc.text().substr(offset, removed);
+            const bool ok = doc.edit(offset, removed, inserted);
+            ++(ok ? parsed : failed);
+            // Broken edits are always undone, others half the time, so the text keeps parsing
+            if (!ok || random() % 2 == 0) {
+                doc.edit(offset, inserted.size(), previous);
+            }
+        }
+        ent::test::check(parsed > 300 && failed > 300, std::format("{} edits parsed, {} failed", parsed, failed));
+    }
+}
+
+int main() {
+    ent::preprocessor pp("main.e");
+    const std::string text = pp.get_preprocessed() +
+        "fn strings() -> void {\n    byte* a = \"one /* not a comment */\";\n    /* not \"a string\" */\n    byte* b = \"two\";\n};\n";
+    ent::test::check(rebuilt(text).error.empty(), "sample must parse");
+    check_spanning(text);
+    check_random(text);
+    return ent::test::result();
+}
@@ -0,0 +1,48 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Lexes sources split into spans of every size and checks the tokens and line numbers come out
+// the same as from one contiguous string, covering tokens carried across one or more span ends.
+#include "Check.hh"
+#include "Lexer.hh"
+#include "Rope.hh"
+#include <string>
+#include <vector>
+
+namespace {
+    bool same(const ent::lexer::token& a, const ent::lexer::token& b) {
+        return a.type == b.type && a.offset == b.offset && a.length == b.length && a.symbol == b.symbol
+            && a.first_on_line == b.first_on_line;
+    }
+
+    void check_splits(const std::string_view name, const std::string& text) {
+        ent::lexer whole{std::string_view(text)};
+        const auto& expected = whole.get_tokens();
+        for (size_t size = 1; size <= 300; ++size) {
+            ent::source_rope rope;
+            for (size_t at = 0; at < text.size(); at += size) {
+                rope.append(std::string_view(text).substr(at, size));
+                // Marking keeps adjacent views from being merged back into one span
+                rope.mark();
+            }
+            ent::lexer split(rope);
+            const auto& tokens = split.get_tokens();
+            bool ok = tokens.size() == expected.size();
+            for (size_t i = 0; ok && i < tokens.size(); ++i) {
+                ok = same(tokens[i], expected[i]) && split.get_lines().line(tokens[i].offset) == whole.get_lines().line(expected[i].offset);
+            }
+            ent::lexer streamed(rope, ent::lexer::streaming);
+            for (size_t i = 0; ok && i < expected.size(); ++i) {
+                ok = same(streamed.pull(), expected[i]);
+            }
+            ent::test::check(ok, std::format("{} split into spans of {} bytes", name, size));
+        }
+    }
+}
+
+int main() {
+    check_splits("main.e", ent::test::read_file("main.e"));
+    check_splits("long comment and string", std::format("a = b;\n/*{}*/ x == \"{}\\\"\" y\n// {}\nz;\n",
+        std::string(700, '*'), std::string(900, 's'), std::string(500, 'c')));
+    return ent::test::result();
+}
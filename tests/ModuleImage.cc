@@ -0,0 +1,111 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Serializes the sample programs and checks that the loaded tree prints the same as the parsed one,
+// and that damaged images are rejected with module_error instead of crashing or allocating wildly.
+#include "Arena.hh"
+#include "Check.hh"
+#include "Lexer.hh"
+#include "Macro.hh"
+#include "Parser.hh"
+#include "Preprocessor.hh"
+#include "Serialize.hh"
+#include <cstring>
+#include <random>
+
+namespace {
+    std::string printed(const ent::ast::base_node& node) {
+        return ent::test::captured_stdout([&node] { node.print(0); });
+    }
+
+    ent::ast::base_node_ptr parse(const std::string& path, ent::arena& nodes) {
+        const ent::preprocessor pp(path);
+        ent::lexer lexer(pp.get_rope());
+        ent::macro_expander macros(std::move(lexer.get_tokens()), lexer.get_lines());
+        ent::parser parser(std::move(macros.get_tokens()), std::move(lexer.get_lines()), nodes);
+        return parser.parse_program();
+    }
+
+    // The error deserializing `image` stopped with, empty if it loaded
+    std::string load_error(const std::string& image) {
+        try {
+            ent::arena nodes;
+            const ent::ast::base_node_ptr loaded = ent::ast::deserialize(image, nodes);
+            printed(*loaded);
+            return {};
+        } catch (const ent::module_error& e) {
+            return e.what();
+        }
+    }
+
+    void check_round_trip(const std::string& path) {
+        ent::arena parsed_nodes;
+        const ent::ast::base_node_ptr parsed = parse(path, parsed_nodes);
+        const std::string image = ent::ast::serialize(*parsed, 42);
+        ent::arena loaded_nodes;
+        const ent::ast::base_node_ptr loaded = ent::ast::deserialize(image, loaded_nodes);
+        ent::test::check(printed(*parsed) == printed(*loaded), std::format("{}: loaded tree prints differently", path));
+        ent::test::check(ent::ast::source_hash(image) == 42, std::format("{}: source hash", path));
+    }
+
+    void check_corrupt(const std::string& image) {
+        // Header words: magic, version, node kinds, node count
+        std::string huge_count = image;
+        constexpr std::uint32_t count = 0xffffffff;
+        std::memcpy(huge_count.data() + 3 * sizeof(std::uint32_t), &count, sizeof(count));
+        ent::test::check(!load_error(huge_count).empty(), "node count of 0xffffffff");
+
+        std::string short_count = image;
+        std::uint32_t fewer;
+        std::memcpy(&fewer, short_count.data() + 3 * sizeof(std::uint32_t), sizeof(fewer));
+        --fewer;
+        std::memcpy(short_count.data() + 3 * sizeof(std::uint32_t), &fewer, sizeof(fewer));
+        ent::test::check(!load_error(short_count).empty(), "node count one short");
+
+        for (size_t size = 0; size < image.size(); ++size) {
+            if (load_error(image.substr(0, size)).empty()) {
+                ent::test::check(false, std::format("image truncated to {} bytes loaded", size));
+                break;
+            }
+        }
+
+        // Flipped bits may still load into some other valid tree, they only must not crash
+        std::mt19937 random(3);
+        for (int round = 0; round < 2000; ++round) {
+            std::string damaged = image;
+            for (int flips = 1 + static_cast<int>(random() % 4); flips > 0; --flips) {
+                damaged[random() % damaged.size()] ^= static_cast<char>(1 << random() % 8);
+            }
+            load_error(damaged);
+        }
+    }
+    // A variable declaration has the fields of a parameter, only its kind tells them apart
+    void check_swapped_kind() {
+        const std::string source = "fn add(word a, word b) -> word;";
+        ent::lexer lexer{std::string_view(source)};
+        ent::arena nodes;
+        ent::parser parser(std::move(lexer.get_tokens()), std::move(lexer.get_lines()), nodes);
+        std::string image = ent::ast::serialize(*parser.parse_program(), 42);
+        ent::test::check(load_error(image).empty(), "prototype loads");
+
+        // Header word 10 holds the size of the node section, which ends the image. Records come
+        // after their children, so the first is the parameter `a`, starting with its tag.
+        std::uint32_t node_bytes;
+        std::memcpy(&node_bytes, image.data() + 10 * sizeof(std::uint32_t), sizeof(node_bytes));
+        char& tag = image[image.size() - node_bytes];
+        ent::test::check(tag == static_cast<char>(ent::ast::NODE_TYPE::Parameter), "first record is a parameter");
+        tag = static_cast<char>(ent::ast::NODE_TYPE::VariableDeclaration);
+        ent::test::check(!load_error(image).empty(), "variable declaration in a parameter list");
+    }
+}
+
+int main() {
+    // test.e and math.e leave out the ';' after function bodies and do not parse
+    for (const char* path : {"main.e", "float.e"}) {
+        check_round_trip(path);
+    }
+    ent::arena nodes;
+    check_corrupt(ent::ast::serialize(*parse("main.e", nodes), 42));
+    check_swapped_kind();
+    return ent::test::result();
+}
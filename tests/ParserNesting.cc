@@ -0,0 +1,51 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Deeply nested expressions must stop with a parser_error, not run the parser off its stack.
+#include "Arena.hh"
+#include "Check.hh"
+#include "Lexer.hh"
+#include "Parser.hh"
+#include <string>
+
+namespace {
+    std::string repeat(const std::string_view text, const size_t count) {
+        std::string out;
+        out.reserve(text.size() * count);
+        for (size_t i = 0; i < count; ++i) {
+            out += text;
+        }
+        return out;
+    }
+
+    // The error the parser stopped with, empty if it accepted the program
+    std::string parse(const std::string& body) {
+        const std::string source = "fn f(dword a) -> dword {\n    " + body + "\n};\n";
+        try {
+            ent::lexer lexer{std::string_view(source)};
+            ent::arena nodes;
+            ent::parser parser(std::move(lexer.get_tokens()), std::move(lexer.get_lines()), nodes);
+            parser.parse_program();
+            return {};
+        } catch (const ent::parser_error& e) {
+            return e.what();
+        }
+    }
+
+    void check_too_deep(const std::string_view name, const std::string& body) {
+        const std::string error = parse(body);
+        ent::test::check(error.contains("nested too deeply"), std::format("{}: got \"{}\"", name, error));
+    }
+}
+
+int main() {
+    constexpr size_t deep = 200000;
+    check_too_deep("chained assignments", repeat("a = ", deep) + "1;");
+    check_too_deep("parentheses", "return " + repeat("(", deep) + "1" + repeat(")", deep) + ";");
+    check_too_deep("prefix operators", "return " + repeat("-", deep) + "1;");
+    check_too_deep("call arguments", "return " + repeat("g(", deep) + "1" + repeat(")", deep) + ";");
+
+    ent::test::check(parse(repeat("a = ", 500) + "1;").empty(), "500 chained assignments");
+    ent::test::check(parse("return " + repeat("(", 500) + "1" + repeat(")", 500) + ";").empty(), "500 parentheses");
+    return ent::test::result();
+}
@@ -0,0 +1,99 @@
+//
+// Created by notbonzo on 10/16/26.
+//
+// Runs every scan kernel set the CPU supports against the scalar set. Dispatch only ever picks one
+// of them, so this is where the others get exercised.
+#include "Check.hh"
+#include "Lexer.hh"
+#include "Scan.hh"
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+    using kernel = const char* (*)(const char*, const char*);
+
+    struct probe {
+        std::string_view name;
+        kernel ent::scan::kernels::* function;
+        // Filler the kernel runs over, and characters that must stop it
+        char run;
+        std::string_view stops;
+    };
+
+    constexpr probe probes[] = {
+        {"skip_whitespace", &ent::scan::kernels::skip_whitespace, ' ', "x\x80\x01"},
+        {"skip_identifier", &ent::scan::kernels::skip_identifier, 'q', " @[`{/:\x80"},
+        {"find_newline", &ent::scan::kernels::find_newline, 'x', "\n"},
+        {"find_star", &ent::scan::kernels::find_star, 'x', "*"},
+        {"find_string_special", &ent::scan::kernels::find_string_special, 'x', "\"\\"},
+    };
+
+    // Every length across the 16 and 32 byte block edges, with the stop at every position or
+    // missing. Buffers are sized exactly, so a kernel reading past `last` shows up under ASan.
+    void check_boundaries(const ent::scan::kernels& set) {
+        for (const probe& p : probes) {
+            for (size_t length = 0; length <= 100; ++length) {
+                for (const char stop : p.stops) {
+                    for (size_t at = 0; at <= length; ++at) {
+                        const auto buffer = std::make_unique<char[]>(length + 1);
+                        std::fill_n(buffer.get(), length, p.run);
+                        if (at < length) {
+                            buffer[at] = stop;
+                        }
+                        const char* first = buffer.get();
+                        const char* found = (set.*p.function)(first, first + length);
+                        ent::test::check(found == first + at, std::format("{} {}: length {}, stop {:#x} at {}, got {}",
+                            set.name, p.name, length, static_cast<unsigned char>(stop), at, found - first));
+                    }
+                }
+            }
+        }
+    }
+
+    void check_random(const ent::scan::kernels& set, const ent::scan::kernels& scalar) {
+        std::mt19937 random(7);
+        constexpr std::string_view alphabet = " \t\r\nabzAZ09_*/\"\\@[`{\x80\xff\x01";
+        for (int round = 0; round < 20000; ++round) {
+            std::string text(random() % 100, ' ');
+            for (char& c : text) {
+                c = random() % 4 == 0 ? static_cast<char>(random()) : alphabet[random() % alphabet.size()];
+            }
+            const char* first = text.data() + (text.empty() ? 0 : random() % text.size());
+            const char* last = text.data() + text.size();
+            for (const probe& p : probes) {
+                if ((set.*p.function)(first, last) != (scalar.*p.function)(first, last)) {
+                    ent::test::check(false, std::format("{} {} differs from scalar on round {}", set.name, p.name, round));
+                    return;
+                }
+            }
+        }
+    }
+
+    std::vector<ent::lexer::token> lex(const std::string& text) {
+        ent::lexer lexer{std::string_view(text)};
+        return lexer.get_tokens();
+    }
+}
+
+int main() {
+    const auto& sets = ent::scan::supported();
+    const ent::scan::kernels& scalar = *sets.back();
+    for (const ent::scan::kernels* set : sets) {
+        std::print("checking {}\n", set->name);
+        check_boundaries(*set);
+        check_random(*set, scalar);
+    }
+
+    // The lexer must produce the same tokens whichever set it runs on. Input ends in a newline,
+    // as preprocessed text always does.
+    std::string text = ent::test::read_file("main.e");
+    text += "/* a comment that runs past several blocks of thirty-two bytes ** */ \"a string \\\" with escapes\" x\n";
+    ent::scan::override_active(scalar);
+    const std::vector<ent::lexer::token> expected = lex(text);
+    for (const ent::scan::kernels* set : sets) {
+        ent::scan::override_active(*set);
+        ent::test::check(lex(text) == expected, std::format("lexer tokens differ under {}", set->name));
+    }
+    return ent::test::result();
+}